@@ -0,0 +1,614 @@
+// Parser benchmark and differential check against glibc getopt_long.
+//
+// Build and run with `make bench`. Every case runs in its own process so peak RSS is per case.
+// Linux/glibc only: allocations are counted by interposing malloc, L1 data cache misses with perf_event_open
+// where the kernel exposes the counter, and are shown as "-" otherwise.
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <time.h>
+#include <unistd.h>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+
+#include "dash.h"
+
+// Linear parsers are skipped above this many token x option comparisons
+#define MAX_LINEAR_WORK 1000000000.0
+// getopt_long permutes non-options one by one, which is quadratic in the number of tokens
+#define MAX_GETOPT_TOKENS 100000
+#define TARGET_NANOSECONDS 200000000.0
+
+static const char short_names[] = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ";
+
+extern void* __libc_malloc(size_t size);
+extern void* __libc_calloc(size_t count, size_t size);
+extern void* __libc_realloc(void* pointer, size_t size);
+
+static size_t allocation_count = 0;
+
+void* malloc(size_t size)
+{
+    allocation_count++;
+    return __libc_malloc(size);
+}
+
+void* calloc(size_t count, size_t size)
+{
+    allocation_count++;
+    return __libc_calloc(count, size);
+}
+
+void* realloc(void* pointer, size_t size)
+{
+    allocation_count++;
+    return __libc_realloc(pointer, size);
+}
+
+typedef struct {
+    int option_count;
+    dash_Longopt* options;
+    bool* flags;
+    char** values;
+    char** names;
+    struct option* getopt_options;
+    char* getopt_string;
+    int getopt_short_index[256];
+} Table;
+
+typedef struct {
+    int argc;
+    char** argv;
+} Corpus;
+
+typedef struct {
+    bool ok;
+    bool* flags;
+    char** values;
+    int argc;
+    char** argv;
+} Result;
+
+static double now(void)
+{
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return time.tv_sec * 1e9 + time.tv_nsec;
+}
+
+// Counter of L1 data cache read misses of this process in user space, -1 when there is none
+static int open_cache_misses(void)
+{
+    struct perf_event_attr attributes;
+
+    memset(&attributes, 0, sizeof(attributes));
+    attributes.size = sizeof(attributes);
+    attributes.type = PERF_TYPE_HW_CACHE;
+    attributes.config = PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+    attributes.disabled = 1;
+    attributes.exclude_kernel = 1;
+    attributes.exclude_hv = 1;
+    return (int) syscall(SYS_perf_event_open, &attributes, 0, -1, -1, 0);
+}
+
+static char* format(const char* pattern, int value)
+{
+    char buffer[64];
+    snprintf(buffer, sizeof(buffer), pattern, value);
+    return strdup(buffer);
+}
+
+static void build_table(Table* table, int option_count)
+{
+    int getopt_length = 0;
+
+    table->option_count = option_count;
+    table->options = calloc(option_count + 1, sizeof(dash_Longopt));
+    table->flags = calloc(option_count, sizeof(bool));
+    table->values = calloc(option_count, sizeof(char*));
+    table->names = calloc(option_count, sizeof(char*));
+    table->getopt_options = calloc(option_count + 1, sizeof(struct option));
+    table->getopt_string = calloc(2 * sizeof(short_names) + 2, 1);
+    memset(table->getopt_short_index, -1, sizeof(table->getopt_short_index));
+
+    // Don't print errors, don't stop at the first non-option
+    table->getopt_string[getopt_length++] = ':';
+
+    for (int i = 0; i < option_count; i++)
+    {
+        dash_Longopt* option = &table->options[i];
+        bool has_param = i % 3 == 1;
+
+        table->names[i] = format("option-%d", i);
+        option->longopt_name = table->names[i];
+        option->param_name = has_param ? "value" : NULL;
+        option->user_pointer = has_param ? (void*) &table->values[i] : (void*) &table->flags[i];
+        if (i < (int) sizeof(short_names) - 1)
+        {
+            option->opt_name = short_names[i];
+            option->allow_flag_unset = i % 4 == 0;
+            table->getopt_string[getopt_length++] = short_names[i];
+            if (has_param)
+            {
+                table->getopt_string[getopt_length++] = ':';
+            }
+            table->getopt_short_index[(unsigned char) short_names[i]] = i;
+        }
+
+        table->getopt_options[i].name = table->names[i];
+        table->getopt_options[i].has_arg = has_param ? required_argument : no_argument;
+        table->getopt_options[i].val = 256 + i;
+    }
+}
+
+static int pick(int count)
+{
+    return rand() % count;
+}
+
+// Pick an option matching the predicate, -1 if none was found after a few tries
+static int pick_option(const Table* table, int limit, bool want_param, bool want_unset, const bool* used)
+{
+    for (int tries = 0; tries < 16; tries++)
+    {
+        int i = pick(limit);
+        bool has_param = table->options[i].param_name != NULL;
+        if (has_param != want_param || (want_unset && !table->options[i].allow_flag_unset))
+        {
+            continue;
+        }
+        if (has_param && used[i])
+        {
+            continue;
+        }
+        return i;
+    }
+    return -1;
+}
+
+// Mix of positionals, short clusters, +X unsets, attached and separate values, --long=value and a final --
+static void build_corpus(Corpus* corpus, const Table* table, int token_count, bool with_unset)
+{
+    int short_count = table->option_count < (int) sizeof(short_names) - 1 ? table->option_count : (int) sizeof(short_names) - 1;
+    bool* used = calloc(table->option_count, sizeof(bool));
+    char buffer[256];
+    int length;
+    int i;
+
+    corpus->argv = calloc(token_count + 2, sizeof(char*));
+    corpus->argv[0] = "bench";
+    corpus->argc = 1;
+
+    while (corpus->argc <= token_count)
+    {
+        int kind = pick(10);
+        int remaining = token_count + 1 - corpus->argc;
+
+        if (remaining > 4 && corpus->argc > token_count - 4 && pick(2) == 0)
+        {
+            // End of options, everything after is positional
+            corpus->argv[corpus->argc++] = strdup("--");
+            while (corpus->argc <= token_count)
+            {
+                corpus->argv[corpus->argc] = pick(2) ? strdup("-a") : format("after-%d", corpus->argc);
+                corpus->argc++;
+            }
+            break;
+        }
+
+        switch (kind)
+        {
+            case 0:
+            case 1:
+                corpus->argv[corpus->argc] = pick(8) ? format("file-%d", corpus->argc) : strdup("-");
+                corpus->argc++;
+                continue;
+            case 2:
+            case 3:
+                // Short cluster of flags, or of unsets
+                if (kind == 3 && with_unset)
+                {
+                    buffer[0] = '+';
+                }
+                else
+                {
+                    buffer[0] = '-';
+                }
+                length = 1;
+                for (int k = 1 + pick(4); k > 0; k--)
+                {
+                    if ((i = pick_option(table, short_count, false, buffer[0] == '+', used)) != -1)
+                    {
+                        buffer[length++] = table->options[i].opt_name;
+                    }
+                }
+                if (length == 1)
+                {
+                    continue;
+                }
+                buffer[length] = '\0';
+                corpus->argv[corpus->argc++] = strdup(buffer);
+                continue;
+            case 4:
+                // Short option with its value attached
+                if ((i = pick_option(table, short_count, true, false, used)) == -1)
+                {
+                    continue;
+                }
+                used[i] = true;
+                snprintf(buffer, sizeof(buffer), "-%cvalue%d", table->options[i].opt_name, i);
+                corpus->argv[corpus->argc++] = strdup(buffer);
+                continue;
+            case 5:
+            case 6:
+                if ((i = pick_option(table, table->option_count, false, false, used)) == -1)
+                {
+                    continue;
+                }
+                snprintf(buffer, sizeof(buffer), "--%s", table->names[i]);
+                corpus->argv[corpus->argc++] = strdup(buffer);
+                continue;
+            case 7:
+            case 8:
+                if ((i = pick_option(table, table->option_count, true, false, used)) == -1)
+                {
+                    continue;
+                }
+                used[i] = true;
+                snprintf(buffer, sizeof(buffer), "--%s=value%d", table->names[i], i);
+                corpus->argv[corpus->argc++] = strdup(buffer);
+                continue;
+            default:
+                // Option and value as two tokens
+                if (remaining < 2 || (i = pick_option(table, table->option_count, true, false, used)) == -1)
+                {
+                    continue;
+                }
+                used[i] = true;
+                snprintf(buffer, sizeof(buffer), "--%s", table->names[i]);
+                corpus->argv[corpus->argc++] = strdup(buffer);
+                corpus->argv[corpus->argc++] = format("separate%d", i);
+                continue;
+        }
+    }
+    corpus->argv[corpus->argc] = NULL;
+    free(used);
+}
+
+static bool run_dash(const Table* table, const dash_Index* index, int argc, char** argv)
+{
+    if (index != NULL)
+    {
+        return dash_arg_parser_compiled(&argc, argv, index);
+    }
+    return dash_arg_parser(&argc, argv, table->options);
+}
+
+static bool run_getopt(const Table* table, int* argc, char** argv)
+{
+    int c;
+    int option_index;
+    int i;
+
+    memset(table->flags, 0, table->option_count * sizeof(bool));
+    memset(table->values, 0, table->option_count * sizeof(char*));
+
+    optind = 0;
+    opterr = 0;
+    while ((c = getopt_long(*argc, argv, table->getopt_string, table->getopt_options, &option_index)) != -1)
+    {
+        if (c == '?' || c == ':')
+        {
+            return false;
+        }
+        i = c >= 256 ? c - 256 : table->getopt_short_index[c];
+        if (table->options[i].param_name != NULL)
+        {
+            table->values[i] = optarg;
+        }
+        else
+        {
+            table->flags[i] = true;
+        }
+    }
+
+    // Permuted arguments: options first, then positionals from optind
+    for (int k = optind; k < *argc; k++)
+    {
+        argv[k - optind + 1] = argv[k];
+    }
+    *argc = *argc - optind + 1;
+    return true;
+}
+
+static void capture(Result* result, const Table* table, bool ok, int argc, char** argv, bool strip_polarity)
+{
+    result->ok = ok;
+    result->flags = malloc(table->option_count * sizeof(bool));
+    result->values = malloc(table->option_count * sizeof(char*));
+    memcpy(result->flags, table->flags, table->option_count * sizeof(bool));
+    for (int i = 0; i < table->option_count; i++)
+    {
+        const char* value = table->values[i];
+        // dash prefixes values of options allowing unset with their polarity
+        if (value != NULL && strip_polarity && table->options[i].allow_flag_unset)
+        {
+            value++;
+        }
+        result->values[i] = value != NULL ? strdup(value) : NULL;
+    }
+    result->argc = argc;
+    result->argv = malloc(argc * sizeof(char*));
+    memcpy(result->argv, argv, argc * sizeof(char*));
+}
+
+static bool compare(const Table* table, const Result* expected, const Result* actual, const char* name)
+{
+    if (expected->ok != actual->ok)
+    {
+        fprintf(stderr, "%s: parse %s instead of %s\n", name, actual->ok ? "succeeded" : "failed", expected->ok ? "succeeding" : "failing");
+        return false;
+    }
+    if (!expected->ok)
+    {
+        return true;
+    }
+    for (int i = 0; i < table->option_count; i++)
+    {
+        if (expected->flags[i] != actual->flags[i])
+        {
+            fprintf(stderr, "%s: flag --%s differs\n", name, table->names[i]);
+            return false;
+        }
+        if ((expected->values[i] == NULL) != (actual->values[i] == NULL) || (expected->values[i] != NULL && strcmp(expected->values[i], actual->values[i])))
+        {
+            fprintf(stderr, "%s: value of --%s differs: %s / %s\n", name, table->names[i], expected->values[i], actual->values[i]);
+            return false;
+        }
+    }
+    if (expected->argc != actual->argc)
+    {
+        fprintf(stderr, "%s: %d remaining arguments instead of %d\n", name, actual->argc, expected->argc);
+        return false;
+    }
+    for (int i = 0; i < expected->argc; i++)
+    {
+        if (strcmp(expected->argv[i], actual->argv[i]))
+        {
+            fprintf(stderr, "%s: remaining argument %d differs: %s / %s\n", name, i, expected->argv[i], actual->argv[i]);
+            return false;
+        }
+    }
+    return true;
+}
+
+// dash_arg_parser is the reference: the compiled index must always agree, and getopt_long too when there is no +X
+static bool differential(int option_count, int token_count, unsigned seed)
+{
+    Table table;
+    Corpus corpus;
+    dash_Index index;
+    Result results[3];
+    char** argv;
+    int argc;
+    bool ok = true;
+
+    srand(seed);
+    build_table(&table, option_count);
+    if (!dash_compile_options(&index, table.options))
+    {
+        fputs("dash_compile_options failed\n", stderr);
+        return false;
+    }
+
+    for (int with_unset = 0; with_unset < 2 && ok; with_unset++)
+    {
+        build_corpus(&corpus, &table, token_count, with_unset);
+        argv = malloc((corpus.argc + 1) * sizeof(char*));
+
+        for (int parser = 0; parser < 3; parser++)
+        {
+            memcpy(argv, corpus.argv, (corpus.argc + 1) * sizeof(char*));
+            argc = corpus.argc;
+            if (parser == 2)
+            {
+                results[parser].ok = run_getopt(&table, &argc, argv);
+                capture(&results[parser], &table, results[parser].ok, argc, argv, false);
+                continue;
+            }
+            if (parser == 0)
+            {
+                results[parser].ok = dash_arg_parser(&argc, argv, table.options);
+            }
+            else
+            {
+                results[parser].ok = dash_arg_parser_compiled(&argc, argv, &index);
+            }
+            capture(&results[parser], &table, results[parser].ok, argc, argv, true);
+            dash_free(table.options);
+        }
+
+        ok = compare(&table, &results[0], &results[1], "dash_arg_parser_compiled") && (with_unset || compare(&table, &results[0], &results[2], "getopt_long"));
+        if (!results[0].ok)
+        {
+            fputs("dash_arg_parser rejected a generated corpus\n", stderr);
+            ok = false;
+        }
+        if (!ok)
+        {
+            fprintf(stderr, "  table of %d options, %d tokens, seed %u:", option_count, token_count, seed);
+            for (int i = 1; i < corpus.argc && i < 20; i++)
+            {
+                fprintf(stderr, " %s", corpus.argv[i]);
+            }
+            fputc('\n', stderr);
+        }
+        free(argv);
+    }
+    return ok;
+}
+
+static void measure(int option_count, int token_count, int parser)
+{
+    static const char* parser_names[] = {"dash_arg_parser", "dash_compiled", "getopt_long", "dash_restore"};
+    Table table;
+    Corpus corpus;
+    dash_Index index;
+    char** argv;
+    int argc;
+    long iterations = 1;
+    double elapsed;
+    size_t allocations;
+    struct rusage usage;
+    int counter = open_cache_misses();
+    long long misses = 0;
+    char misses_text[32] = "-";
+    bool ok = true;
+    unsigned char* snapshot = NULL;
+    size_t snapshot_size = 0;
+
+    srand(option_count * 31 + token_count);
+    build_table(&table, option_count);
+    build_corpus(&corpus, &table, token_count, true);
+    if ((parser == 1 || parser == 3) && !dash_compile_options(&index, table.options))
+    {
+        exit(1);
+    }
+
+    if ((parser != 1 && parser != 3 && (double) (corpus.argc - 1) * option_count > MAX_LINEAR_WORK) || (parser == 2 && corpus.argc - 1 > MAX_GETOPT_TOKENS))
+    {
+        printf("%-16s %8d %9d %12s\n", parser_names[parser], option_count, corpus.argc - 1, "skipped");
+        exit(0);
+    }
+
+    argv = malloc((corpus.argc + 1) * sizeof(char*));
+
+    // Workers bind the values of a parse made once, the time per token is the one of the parse it replaces
+    if (parser == 3)
+    {
+        memcpy(argv, corpus.argv, (corpus.argc + 1) * sizeof(char*));
+        ok &= run_dash(&table, &index, corpus.argc, argv);
+        snapshot_size = dash_snapshot(NULL, 0, table.options);
+        snapshot = malloc(snapshot_size);
+        dash_snapshot(snapshot, snapshot_size, table.options);
+        dash_free(table.options);
+    }
+
+    // Grow the iteration count until a run takes long enough to be measured
+    while (true)
+    {
+        allocations = allocation_count;
+        if (counter != -1)
+        {
+            ioctl(counter, PERF_EVENT_IOC_RESET, 0);
+            ioctl(counter, PERF_EVENT_IOC_ENABLE, 0);
+        }
+        elapsed = now();
+        for (long k = 0; k < iterations; k++)
+        {
+            memcpy(argv, corpus.argv, (corpus.argc + 1) * sizeof(char*));
+            argc = corpus.argc;
+            if (parser == 2)
+            {
+                ok &= run_getopt(&table, &argc, argv);
+            }
+            else if (parser == 3)
+            {
+                ok &= dash_restore(snapshot, snapshot_size, table.options, &(dash_Settings) {.index = &index});
+                dash_free_ex(table.options, &(dash_Settings) {.flags = DASH_ZERO_COPY});
+            }
+            else
+            {
+                ok &= run_dash(&table, parser == 1 ? &index : NULL, argc, argv);
+                dash_free(table.options);
+            }
+        }
+        elapsed = now() - elapsed;
+        if (counter != -1)
+        {
+            ioctl(counter, PERF_EVENT_IOC_DISABLE, 0);
+        }
+        allocations = allocation_count - allocations;
+        if (elapsed > TARGET_NANOSECONDS / 10 || iterations > 1000000)
+        {
+            break;
+        }
+        iterations *= 10;
+    }
+
+    // Misses of the whole parse, resetting and freeing the values included, per token
+    if (counter != -1 && read(counter, &misses, sizeof(misses)) == sizeof(misses))
+    {
+        snprintf(misses_text, sizeof(misses_text), "%.2f", (double) misses / iterations / (corpus.argc - 1));
+    }
+    getrusage(RUSAGE_SELF, &usage);
+    printf("%-16s %8d %9d %12.2f %12s %12.2f %10ld %s\n", parser_names[parser], option_count, corpus.argc - 1,
+        elapsed / iterations / (corpus.argc - 1), misses_text, (double) allocations / iterations, usage.ru_maxrss, ok ? "" : "(parse failed)");
+    exit(0);
+}
+
+int main(int argc, char* argv[])
+{
+    static const int option_counts[] = {10, 100, 1000, 10000};
+    static const int token_counts[] = {1, 100, 10000, 1000000};
+    pid_t child;
+    int status;
+
+    (void) argc;
+    (void) argv;
+
+    // Run the check in a child too, so its memory doesn't show up in the peak RSS of the measurements
+    puts("Differential check against getopt_long");
+    fflush(stdout);
+    child = fork();
+    if (child == 0)
+    {
+        for (size_t t = 0; t < sizeof(option_counts) / sizeof(option_counts[0]); t++)
+        {
+            for (int token_count = 1; token_count <= 10000; token_count *= 10)
+            {
+                for (unsigned seed = 1; seed <= 20; seed++)
+                {
+                    if (!differential(option_counts[t], token_count, seed))
+                    {
+                        exit(1);
+                    }
+                }
+            }
+        }
+        exit(0);
+    }
+    waitpid(child, &status, 0);
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+    {
+        return 1;
+    }
+    puts("  ok");
+
+    printf("\n%-16s %8s %9s %12s %12s %12s %10s\n", "parser", "options", "tokens", "ns/token", "misses/token", "allocs/parse", "peak KiB");
+    fflush(stdout);
+    for (size_t t = 0; t < sizeof(option_counts) / sizeof(option_counts[0]); t++)
+    {
+        for (size_t k = 0; k < sizeof(token_counts) / sizeof(token_counts[0]); k++)
+        {
+            for (int parser = 0; parser < 4; parser++)
+            {
+                child = fork();
+                if (child == 0)
+                {
+                    measure(option_counts[t], token_counts[k], parser);
+                }
+                waitpid(child, &status, 0);
+                fflush(stdout);
+            }
+        }
+    }
+    return 0;
+}
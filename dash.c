@@ -8,16 +8,163 @@ The above copyright notice and this permission notice shall be included in all c
 THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 */
 
+// locale_t and MAP_ANONYMOUS aren't part of ISO C, strict modes (-std=c11) hide them
+#define _POSIX_C_SOURCE 200809L
+#define _DEFAULT_SOURCE
+#define _DARWIN_C_SOURCE
+
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
+#include <inttypes.h>
+#include <float.h>
+#include <locale.h>
 
 #if defined(_WIN32) || defined(WIN32)
     #include <windows.h>
+    #include <io.h>
+#else
+    #include <errno.h>
+    #include <fcntl.h>
+    #include <unistd.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <pthread.h>
+#endif
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) && defined(__SSE2__)
+    #include <immintrin.h>
+    #define HAVE_SSE2
+    #define HAVE_AVX2
+#elif defined(_MSC_VER) && defined(_M_X64)
+    #include <intrin.h>
+    #define HAVE_SSE2
 #endif
 
 #include "dash.h"
 
+#if defined(_WIN32) || defined(WIN32)
+    #define environ _environ
+#else
+    extern char** environ;
+#endif
+
+// Instrumentation is compiled out unless DASH_STATS is defined, the STATS_ macros then expand to nothing
+#ifdef DASH_STATS
+    #include <time.h>
+
+    #if defined(_MSC_VER)
+        #define THREAD_LOCAL __declspec(thread)
+    #else
+        #define THREAD_LOCAL _Thread_local
+    #endif
+
+    // Counters of the call in progress on this thread, added to the totals when it returns
+    typedef struct {
+        dash_Stats counters;
+        dash_Phase phase;
+        uint64_t since;
+        int depth;
+    } Stats_Scope;
+
+    static THREAD_LOCAL Stats_Scope stats_scope;
+    static dash_Stats stats_total;
+    static dash_Trace stats_trace;
+    static void* stats_trace_data;
+
+    static uint64_t stats_clock(void)
+    {
+        #if defined(_WIN32) || defined(WIN32)
+            LARGE_INTEGER counter;
+            LARGE_INTEGER frequency;
+
+            QueryPerformanceCounter(&counter);
+            QueryPerformanceFrequency(&frequency);
+            return (uint64_t) (counter.QuadPart * (1000000000.0 / frequency.QuadPart));
+        #else
+            struct timespec time;
+
+            clock_gettime(CLOCK_MONOTONIC, &time);
+            return (uint64_t) time.tv_sec * 1000000000u + (uint64_t) time.tv_nsec;
+        #endif
+    }
+
+    static void stats_add(uint64_t* total, uint64_t amount)
+    {
+        #if defined(_WIN32) || defined(WIN32)
+            InterlockedExchangeAdd64((volatile LONG64*) total, (LONG64) amount);
+        #else
+            __atomic_fetch_add(total, amount, __ATOMIC_RELAXED);
+        #endif
+    }
+
+    static uint64_t stats_load(uint64_t* total)
+    {
+        #if defined(_WIN32) || defined(WIN32)
+            return (uint64_t) InterlockedOr64((volatile LONG64*) total, 0);
+        #else
+            return __atomic_load_n(total, __ATOMIC_RELAXED);
+        #endif
+    }
+
+    // Nested calls, like dash_arg_parser going through dash_arg_parser_ex, count in the outermost one
+    static void stats_begin(dash_Phase phase)
+    {
+        if (stats_scope.depth++ == 0)
+        {
+            memset(&stats_scope.counters, 0, sizeof(dash_Stats));
+            stats_scope.phase = phase;
+            stats_scope.since = stats_clock();
+        }
+    }
+
+    // Time since the last switch goes to the phase that is ending
+    static void stats_phase(dash_Phase phase)
+    {
+        uint64_t now = stats_clock();
+
+        stats_scope.counters.nanoseconds[stats_scope.phase] += now - stats_scope.since;
+        stats_scope.phase = phase;
+        stats_scope.since = now;
+    }
+
+    static void stats_end(bool parse)
+    {
+        const dash_Stats* counters = &stats_scope.counters;
+
+        if (--stats_scope.depth > 0)
+        {
+            return;
+        }
+        stats_phase(stats_scope.phase);
+        stats_scope.counters.parses = parse;
+        stats_add(&stats_total.parses, counters->parses);
+        stats_add(&stats_total.tokens, counters->tokens);
+        stats_add(&stats_total.entries_compared, counters->entries_compared);
+        stats_add(&stats_total.string_compares, counters->string_compares);
+        stats_add(&stats_total.bytes_copied, counters->bytes_copied);
+        stats_add(&stats_total.allocations, counters->allocations);
+        for (int i = 0; i < DASH_PHASE_COUNT; i++)
+        {
+            stats_add(&stats_total.nanoseconds[i], counters->nanoseconds[i]);
+        }
+        if (parse && stats_trace != NULL)
+        {
+            stats_trace(counters, stats_trace_data);
+        }
+    }
+
+    #define STATS_ADD(field, amount) (stats_scope.counters.field += (amount))
+    #define STATS_BEGIN(phase) stats_begin(phase)
+    #define STATS_PHASE(phase) stats_phase(phase)
+    #define STATS_END(parse) stats_end(parse)
+#else
+    #define STATS_ADD(field, amount) ((void) 0)
+    #define STATS_BEGIN(phase) ((void) 0)
+    #define STATS_PHASE(phase) ((void) 0)
+    #define STATS_END(parse) ((void) 0)
+#endif
+
 enum COLORS {
     COLOR_BLUE,
     COLOR_RED,
@@ -71,44 +218,102 @@ static void print_in_color(FILE* output, const char* str, enum COLORS color)
     #endif
 }
 
+typedef struct {
+    char* buffer;
+    size_t size;
+    size_t length;
+} Text_Buffer;
+
+static void append_text(Text_Buffer* text, const char* str, size_t length)
+{
+    // Keep counting past the end so the caller learns the size it needs
+    if (text->length < text->size)
+    {
+        memcpy(&text->buffer[text->length], str, text->size - text->length < length ? text->size - text->length : length);
+    }
+    text->length += length;
+}
+
+static void append_string(Text_Buffer* text, const char* str)
+{
+    append_text(text, str, strlen(str));
+}
+
+static void append_repeated(Text_Buffer* text, char c, size_t count)
+{
+    if (text->length < text->size)
+    {
+        memset(&text->buffer[text->length], c, text->size - text->length < count ? text->size - text->length : count);
+    }
+    text->length += count;
+}
+
+static void append_in_color(Text_Buffer* text, const char* str, enum COLORS color, bool use_colors)
+{
+    if (!use_colors)
+    {
+        append_string(text, str);
+        return;
+    }
+    switch(color)
+    {
+        case COLOR_BLUE:
+            append_text(text, "\033[34m", 5);
+            break;
+        case COLOR_RED:
+            append_text(text, "\033[31m", 5);
+            break;
+        case COLOR_GREEN:
+            append_text(text, "\033[32m", 5);
+            break;
+    }
+    append_string(text, str);
+    append_text(text, "\033[0m", 4);
+}
+
+static size_t option_prefix_length(const dash_Longopt* option)
+{
+    size_t length = 0;
+    if (option->opt_name != '\0' && option->longopt_name != NULL)
+    {
+        length += 2;
+        // Comma between shortopt and longopt
+    }
+    if (option->opt_name != '\0')
+    {
+        length += 2;
+        // If there is a shortopt
+        if (option->allow_flag_unset)
+        {
+            // If this shortopt has an 'unset' version with '+'
+            length += 3;
+        }
+    }
+    if (option->longopt_name != NULL)
+    {
+        length += 2 + strlen(option->longopt_name);
+        // If there is a longopt
+    }
+    if (option->param_optional && option->param_name != NULL)
+    {
+        length += 2;
+        // If this option has an optional argument, print it inside brackets
+    }
+    if (option->param_name != NULL)
+    {
+        length += strlen(option->param_name);
+        // If this option can be given arguments
+    }
+    return length;
+}
+
 static size_t calculate_print_spacing(const dash_Longopt* options)
 {
     // Calculate the number of spaces to align descriptions
     size_t max_length = 0;
     for (int i = 0; options[i].opt_name != '\0' || options[i].longopt_name != NULL; i++)
     {
-        size_t length = 0;
-        if (options[i].opt_name != '\0' && options[i].longopt_name != NULL)
-        {
-            length += 2;
-            // Comma between shortopt and longopt
-        }
-        if (options[i].opt_name != '\0')
-        {
-            length += 2;
-            // If there is a shortopt
-            if (options[i].allow_flag_unset)
-            {
-                // If this shortopt has an 'unset' version with '+'
-                length += 3;
-            }
-        }
-        if (options[i].longopt_name != NULL)
-        {
-            length += 2 + strlen(options[i].longopt_name);
-            // If there is a longopt
-        }
-        if (options[i].param_optional && options[i].param_name != NULL)
-        {
-            length += 2;
-            // If this option has an optional argument, print it inside brackets
-        }
-        if (options[i].param_name != NULL)
-        {
-            length += strlen(options[i].param_name);
-            // If this option can be given arguments
-        }
-        length += 8;
+        size_t length = option_prefix_length(&options[i]) + 8;
         if (length > max_length)
         {
             max_length = length;
@@ -117,28 +322,27 @@ static size_t calculate_print_spacing(const dash_Longopt* options)
     return max_length;
 }
 
-void dash_print_usage(const char* argv0, const char* header, const char* footer, const char* required_arguments[], const dash_Longopt* options, FILE* output_file)
+static void format_usage(Text_Buffer* text, const char* argv0, const char* header, const char* footer, const char* required_arguments[], const dash_Longopt* options, bool use_colors)
 {
     size_t max_length;
-
-    if(output_file == NULL)
-    {
-        output_file = stderr;
-    }
+    const char* description;
+    const char* dollar;
+    char short_name[5] = {'-', '\0', '/', '+', '\0'};
 
     // Print header
-    fputs(header, output_file);
-    fputc('\n', output_file);
-    fprintf(output_file, "Usage: %s [options]", argv0);
+    append_string(text, header);
+    append_string(text, "\nUsage: ");
+    append_string(text, argv0);
+    append_string(text, " [options]");
     if (required_arguments != NULL)
     {
         for (int i = 0; required_arguments[i] != NULL; i++)
         {
-            fputc(' ', output_file);
-            fputs(required_arguments[i], output_file);
+            append_text(text, " ", 1);
+            append_string(text, required_arguments[i]);
         }
     }
-    fputc('\n', output_file);
+    append_text(text, "\n", 1);
 
     // Calculate spacing
     max_length = calculate_print_spacing(options);
@@ -146,106 +350,163 @@ void dash_print_usage(const char* argv0, const char* header, const char* footer,
     // Start printing
     for (int i = 0; options[i].opt_name != '\0' || options[i].longopt_name != NULL; i++)
     {
-        bool has_short = false;
-        bool has_comma = false;
-        bool has_long = false;
-        bool has_param = false;
-        bool param_is_opt = false;
-        bool has_unsetopt = false;
-        size_t length = 0;
-        size_t diff;
-
-        fputs("  ", output_file);
-
-        if (options[i].opt_name != '\0' && options[i].longopt_name != NULL)
+        append_text(text, "  ", 2);
+        if (options[i].opt_name != '\0')
         {
-            has_comma = true;
-            length += 2;
+            short_name[1] = short_name[4] = options[i].opt_name;
+            append_text(text, short_name, options[i].allow_flag_unset ? 5 : 2);
         }
-        if (options[i].opt_name != '\0')
+        if (options[i].opt_name != '\0' && options[i].longopt_name != NULL)
         {
-            has_short = true;
-            length += 2;
-            if (options[i].allow_flag_unset)
-            {
-                has_unsetopt = true;
-                length += 3;
-            }
+            append_text(text, ", ", 2);
         }
         if (options[i].longopt_name != NULL)
         {
-            has_long = true;
-            length += 2 + strlen(options[i].longopt_name);
+            append_text(text, "--", 2);
+            append_string(text, options[i].longopt_name);
         }
+        append_text(text, " ", 1);
         if (options[i].param_optional && options[i].param_name != NULL)
         {
-            param_is_opt = true;
-            length += 2;
+            append_text(text, "[", 1);
         }
         if (options[i].param_name != NULL)
         {
-            has_param = true;
-            length += strlen(options[i].param_name);
-        }
-        length += 4;
-        if (has_short)
-        {
-            fprintf(output_file, "-%c", options[i].opt_name);
-            if (has_unsetopt)
-            {
-                fprintf(output_file, "/+%c", options[i].opt_name);
-            }
-        }
-        if (has_comma)
-        {
-            fputs(", ", output_file);
+            append_in_color(text, options[i].param_name, COLOR_BLUE, use_colors);
         }
-        if (has_long)
+        if (options[i].param_optional && options[i].param_name != NULL)
         {
-            fprintf(output_file, "--%s", options[i].longopt_name);
+            append_text(text, "]", 1);
         }
-        fputs(" ", output_file);
-        if (param_is_opt)
+        append_repeated(text, ' ', 2 + max_length - (option_prefix_length(&options[i]) + 4));
+
+        // Copy the description in chunks, replacing every '$' with the parameter name
+        description = options[i].description;
+        while (description != NULL && (dollar = strchr(description, '$')) != NULL)
         {
-            fputc('[', output_file);
+            append_text(text, description, dollar - description);
+            append_in_color(text, options[i].param_name != NULL ? options[i].param_name : "$", COLOR_BLUE, use_colors);
+            description = dollar + 1;
         }
-        if (has_param)
+        if (description != NULL)
         {
-            print_in_color(output_file, options[i].param_name, COLOR_BLUE);
+            append_string(text, description);
         }
-        if (param_is_opt)
+        append_text(text, "\n", 1);
+    }
+    append_string(text, footer);
+    append_text(text, "\n", 1);
+}
+
+size_t dash_format_usage(char* buffer, size_t size, const char* argv0, const char* header, const char* footer, const char* required_arguments[], const dash_Longopt* options, bool use_colors)
+{
+    // Leave room for the terminating '\0', like snprintf
+    Text_Buffer text = {.buffer = buffer, .size = size > 0 ? size - 1 : 0, .length = 0};
+
+    format_usage(&text, argv0, header, footer, required_arguments, options, use_colors);
+    if (size > 0)
+    {
+        buffer[text.length < text.size ? text.length : text.size] = '\0';
+    }
+    return text.length;
+}
+
+bool dash_usage_build(dash_Usage* usage, const char* argv0, const char* header, const char* footer, const char* required_arguments[], const dash_Longopt* options, bool use_colors)
+{
+    usage->length = dash_format_usage(NULL, 0, argv0, header, footer, required_arguments, options, use_colors);
+    usage->text = malloc(usage->length + 1);
+    if (usage->text == NULL)
+    {
+        usage->length = 0;
+        return false;
+    }
+    dash_format_usage(usage->text, usage->length + 1, argv0, header, footer, required_arguments, options, use_colors);
+    return true;
+}
+
+bool dash_usage_write(const dash_Usage* usage, int fd)
+{
+    size_t written = 0;
+    long result;
+
+    // A single write in the common case, loop on short writes
+    while (written < usage->length)
+    {
+        #if defined(_WIN32) || defined(WIN32)
+            result = _write(fd, &usage->text[written], (unsigned) (usage->length - written));
+        #else
+            result = write(fd, &usage->text[written], usage->length - written);
+            if (result == -1 && errno == EINTR)
+            {
+                continue;
+            }
+        #endif
+        if (result <= 0)
         {
-            fputc(']', output_file);
+            return false;
         }
-        fputs("  ", output_file);
-        diff = max_length - length;
-        for (size_t j = 0; j < diff; j++)
+        written += (size_t) result;
+    }
+    return true;
+}
+
+void dash_usage_free(dash_Usage* usage)
+{
+    free(usage->text);
+    usage->text = NULL;
+    usage->length = 0;
+}
+
+void dash_print_usage(const char* argv0, const char* header, const char* footer, const char* required_arguments[], const dash_Longopt* options, FILE* output_file)
+{
+    char stack_buffer[4096];
+    char* buffer = stack_buffer;
+    size_t length;
+
+    // Console colors can't be embedded in a buffer on Windows
+    #if defined(_WIN32) || defined(WIN32)
+        bool use_colors = false;
+    #else
+        bool use_colors = true;
+    #endif
+
+    if(output_file == NULL)
+    {
+        output_file = stderr;
+    }
+
+    STATS_BEGIN(DASH_PHASE_USAGE);
+    length = dash_format_usage(stack_buffer, sizeof(stack_buffer), argv0, header, footer, required_arguments, options, use_colors);
+    if (length >= sizeof(stack_buffer))
+    {
+        buffer = malloc(length + 1);
+        STATS_ADD(allocations, 1);
+        if (buffer == NULL)
         {
-            fputc(' ', output_file);
+            // Print what fits rather than nothing
+            buffer = stack_buffer;
+            length = sizeof(stack_buffer) - 1;
         }
-        if(options[i].description != NULL)
+        else
         {
-            for (int j = 0; options[i].description[j] != '\0'; j++)
-            {
-                if (options[i].description[j] != '$')
-                {
-                    fputc(options[i].description[j], output_file);
-                }
-                else
-                {
-                    print_in_color(output_file, options[i].param_name, COLOR_BLUE);
-                }
-            }
+            dash_format_usage(buffer, length + 1, argv0, header, footer, required_arguments, options, use_colors);
         }
-        fputc('\n', output_file);
     }
-    fputs(footer, output_file);
-    fputc('\n', output_file);
+    fwrite(buffer, 1, length, output_file);
+    STATS_ADD(bytes_copied, length);
+    if (buffer != stack_buffer)
+    {
+        free(buffer);
+    }
+    STATS_END(false);
 }
 
 
 void dash_print_summary(int argc, char** argv, const dash_Longopt* options, FILE* output_file)
 {
+    static const char* const type_names[] = {"string", "int64", "uint64", "double", "size", "duration ms", "list", "count"};
+    const dash_List* list;
+    char number[32];
     char* value;
 
     int structure_length = 0;
@@ -256,7 +517,7 @@ void dash_print_summary(int argc, char** argv, const dash_Longopt* options, FILE
     }
     for (int i = 0; i < structure_length; i++)
     {
-        if (options[i].param_name == NULL)
+        if (options[i].param_name == NULL && options[i].type != DASH_TYPE_COUNT)
         {
             if (options[i].longopt_name)
             {
@@ -276,6 +537,43 @@ void dash_print_summary(int argc, char** argv, const dash_Longopt* options, FILE
             }
             fputc('\n', output_file);
         }
+        else if (options[i].type != DASH_TYPE_STRING)
+        {
+            if (options[i].longopt_name)
+            {
+                fprintf(output_file, "%-35s = (%s) ", options[i].longopt_name, type_names[options[i].type]);
+            }
+            else
+            {
+                fprintf(output_file, "%-35c = (%s) ", options[i].opt_name, type_names[options[i].type]);
+            }
+            switch (options[i].type)
+            {
+                case DASH_TYPE_LIST:
+                    list = options[i].user_pointer;
+                    for (int j = 0; j < list->count; j++)
+                    {
+                        fputs(j > 0 ? ", " : "", output_file);
+                        print_in_color(output_file, list->values[j], COLOR_BLUE);
+                    }
+                    fputc('\n', output_file);
+                    continue;
+                case DASH_TYPE_COUNT:
+                    snprintf(number, sizeof(number), "%d", * (int*) options[i].user_pointer);
+                    break;
+                case DASH_TYPE_INT64:
+                    snprintf(number, sizeof(number), "%" PRId64, * (int64_t*) options[i].user_pointer);
+                    break;
+                case DASH_TYPE_DOUBLE:
+                    snprintf(number, sizeof(number), "%g", * (double*) options[i].user_pointer);
+                    break;
+                default:
+                    snprintf(number, sizeof(number), "%" PRIu64, * (uint64_t*) options[i].user_pointer);
+                    break;
+            }
+            print_in_color(output_file, number, COLOR_BLUE);
+            fputc('\n', output_file);
+        }
         else
         {
             if (options[i].longopt_name)
@@ -305,410 +603,4959 @@ void dash_print_summary(int argc, char** argv, const dash_Longopt* options, FILE
     fputc('\n', output_file);
 }
 
-static int strcmp_until_delimiter(const char* str1, const char* str2, char delimiter, int* index_of_delimiter)
+#ifndef HAVE_SSE2
+// Offset of the first delimiter in a token, or of its terminator
+static size_t scan_token_scalar(const char* token, char delimiter)
 {
-    *index_of_delimiter = 0;
-    while (*str1 != '\0')
-    {
-        if (*str1 == delimiter && *str2 == '\0')
-        {
-            return 0;
-        }
-        if (*str2 == '\0')
-        {
-            return -1;
-        }
-        if (*str1 != *str2)
-        {
-            return *str1 - *str2;
-        }
-        str1++;
-        str2++;
-        (*index_of_delimiter)++;
-    }
-    if (*str2 != '\0' && *str2 != delimiter)
+    size_t offset = 0;
+
+    while (token[offset] != '\0' && token[offset] != delimiter)
     {
-        return 1;
+        offset++;
     }
-    return 0;
+    return offset;
 }
+#endif
 
-static int assign_longopt(char** argument, const dash_Longopt* options, int structure_length, bool* arg_provided_with_equal)
+#ifdef HAVE_SSE2
+static int lowest_bit(unsigned mask)
 {
-    int index_of_delimiter;
-    unsigned long argument_length;
+    #if defined(_MSC_VER)
+        unsigned long index;
 
+        _BitScanForward(&index, mask);
+        return (int) index;
+    #else
+        return __builtin_ctz(mask);
+    #endif
+}
 
-    char* dest_addr;
+// Aligned loads never cross a page boundary, so reading around the token can't fault;
+// the sanitizer can't tell and would flag the bytes that are masked out
+#if defined(__GNUC__)
+__attribute__((no_sanitize_address))
+#endif
+static size_t scan_token_sse2(const char* token, char delimiter)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i delimiters = _mm_set1_epi8(delimiter);
+    size_t offset = (size_t) ((uintptr_t) token & 15);
+    const char* block = token - offset;
+    unsigned mask = ~0u << offset;
+    __m128i chunk;
 
-    // Search through all allowed arguments
-    for (int i = 0; i < structure_length; i++)
+    while (true)
     {
-        *arg_provided_with_equal = false;
-        if (options[i].longopt_name == NULL)
+        chunk = _mm_load_si128((const __m128i*) block);
+        mask &= (unsigned) _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(chunk, zero), _mm_cmpeq_epi8(chunk, delimiters)));
+        if (mask != 0)
         {
-            continue;
+            return (size_t) (block + lowest_bit(mask) - token);
         }
+        block += 16;
+        mask = ~0u;
+    }
+}
+#endif
 
-        // Check if argument is longopt with ' ' delimiter
-        if (!strcmp(options[i].longopt_name, &(*argument)[2]))
-        {
-            if (options[i].param_name == NULL)
-            {
-                *((bool*) options[i].user_pointer) = true;
-            }
-            *argument = NULL;
-            return i;
-        }
+#ifdef HAVE_AVX2
+__attribute__((no_sanitize_address, target("avx2")))
+static size_t scan_token_avx2(const char* token, char delimiter)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i delimiters = _mm256_set1_epi8(delimiter);
+    size_t offset = (size_t) ((uintptr_t) token & 31);
+    const char* block = token - offset;
+    unsigned mask = ~0u << offset;
+    __m256i chunk;
 
-        // Check if argument is longopt with '=' delimiter
-        if (options[i].param_name != NULL && !strcmp_until_delimiter(options[i].longopt_name, &(*argument)[2], '=', &index_of_delimiter))
+    while (true)
+    {
+        chunk = _mm256_load_si256((const __m256i*) block);
+        mask &= (unsigned) _mm256_movemask_epi8(_mm256_or_si256(_mm256_cmpeq_epi8(chunk, zero), _mm256_cmpeq_epi8(chunk, delimiters)));
+        if (mask != 0)
         {
-            if ((*argument)[index_of_delimiter + 3] == '\0')
-            {
-                return -1;
-            }
-            *arg_provided_with_equal = true;
-            argument_length = strlen(&(*argument)[index_of_delimiter + 3]);
-            if (*((char**) options[i].user_pointer) != NULL)
-            {
-                return -1;
-            }
-            *((char**) options[i].user_pointer) = malloc((argument_length + 1) * sizeof(char));
-            if(*((char**) options[i].user_pointer) == NULL)
-            {
-                return -1;
-            }
-            dest_addr = * ((char**) options[i].user_pointer);
-            strcpy(&dest_addr[options[i].allow_flag_unset], &(*argument)[index_of_delimiter + 3]);
-            *argument = NULL;
-            return i;
+            return (size_t) (block + lowest_bit(mask) - token);
         }
+        block += 32;
+        mask = ~0u;
     }
-    return -1;
 }
+#endif
 
-static int assign_shortopt(char argument, const dash_Longopt* options, int structure_length, bool unset)
+// Find the '=' of a long option, or the length of a value when it gets copied, 16 or 32 bytes at a time
+static size_t scan_token(const char* token, char delimiter)
 {
-    // Search through all allowed arguments
-    for (int i = 0; i < structure_length; i++)
-    {
-        // Check if argument is what we want
-        if (options[i].opt_name != '\0' && argument == options[i].opt_name)
+    #if defined(HAVE_AVX2)
+        if (__builtin_cpu_supports("avx2"))
         {
-            if (unset && !options[i].allow_flag_unset)
-            {
-                return -1;
-            }
-            if (options[i].param_name == NULL)
-            {
-                *((bool*) options[i].user_pointer) = !unset;
-            }
-            return i;
+            return scan_token_avx2(token, delimiter);
         }
-    }
-    return -1;
+    #endif
+    #if defined(HAVE_SSE2)
+        return scan_token_sse2(token, delimiter);
+    #else
+        return scan_token_scalar(token, delimiter);
+    #endif
 }
 
-bool dash_arg_parser(int* argc, char* argv[], dash_Longopt* options)
+static unsigned hash_longopt(const char* name, size_t length)
 {
-    int argument_non_option_index = 1;
-    int argument_non_option_count = 1;
+    // FNV-1a over the option name
+    unsigned hash = 2166136261u;
+    for (size_t i = 0; i < length; i++)
+    {
+        hash ^= (unsigned char) name[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+// FNV-1a over what decides how the values of a table are stored, so an image is refused by another table
+static uint64_t hash_table(const dash_Longopt* options)
+{
+    uint64_t hash = 14695981039346656037u;
+    unsigned char shape[5];
+
+    for (int i = 0; options[i].opt_name != '\0' || options[i].longopt_name != NULL; i++)
+    {
+        shape[0] = (unsigned char) options[i].opt_name;
+        shape[1] = (unsigned char) options[i].type;
+        shape[2] = options[i].param_name != NULL;
+        shape[3] = options[i].unset_pointer != NULL;
+        shape[4] = options[i].allow_flag_unset;
+        for (size_t k = 0; k < sizeof(shape); k++)
+        {
+            hash ^= shape[k];
+            hash *= 1099511628211u;
+        }
+        for (const char* name = options[i].longopt_name; name != NULL && *name != '\0'; name++)
+        {
+            hash ^= (unsigned char) *name;
+            hash *= 1099511628211u;
+        }
+        // Ends the name, so names can't be cut elsewhere with the same hash
+        hash *= 1099511628211u;
+    }
+    return hash;
+}
+
+// Groups of values reset the same way at the start of a parse
+enum {
+    RESET_FLAG,
+    RESET_COUNT,
+    RESET_STRING,
+    RESET_NUMBER,
+    RESET_LIST,
+    RESET_UNSET,
+    RESET_GROUPS
+};
+
+// A slot of the long name hash table with everything a probe reads: the first eight bytes of the name and its length
+// settle most lookups without reading the option or its name
+typedef struct {
+    uint64_t prefix;
+    unsigned hash;
+    unsigned length;
+    int option;
+} Hot_Slot;
+
+// The parts of a compiled table read on every parse, apart from the descriptions, parameter names and everything else
+// of dash_Longopt, which take a cache line per option. Allocated in one block after this header
+typedef struct {
+    Hot_Slot* long_slots;
+    // The user and unset pointers grouped by how they are reset, group g ends at group_ends[g], so every group is
+    // reset by a loop without branches. Only for tables with pointers
+    void** values;
+    int group_ends[RESET_GROUPS];
+    int fallback_count;
+} Hot_Index;
+
+// First eight bytes of a name, zero padded, compared as a single word
+static uint64_t name_prefix(const char* name, size_t length)
+{
+    uint64_t prefix = 0;
+
+    memcpy(&prefix, name, length < sizeof(prefix) ? length : sizeof(prefix));
+    return prefix;
+}
+
+static int lookup_hot_longopt(const dash_Index* index, const char* name, size_t name_length, unsigned hash)
+{
+    const Hot_Slot* slots = ((const Hot_Index*) index->hot)->long_slots;
+    uint64_t prefix = name_prefix(name, name_length);
+
+    for (size_t slot = hash & index->long_mask; slots[slot].option != -1; slot = (slot + 1) & index->long_mask)
+    {
+        STATS_ADD(entries_compared, 1);
+        if (slots[slot].hash != hash || slots[slot].length != name_length || slots[slot].prefix != prefix)
+        {
+            continue;
+        }
+        if (name_length <= sizeof(prefix))
+        {
+            return slots[slot].option;
+        }
+        STATS_ADD(string_compares, 1);
+        if (!memcmp(&index->options[slots[slot].option].longopt_name[sizeof(prefix)], &name[sizeof(prefix)], name_length - sizeof(prefix)))
+        {
+            return slots[slot].option;
+        }
+    }
+    return -1;
+}
+
+static int lookup_longopt(const dash_Index* index, const char* name, size_t name_length)
+{
+    unsigned hash = hash_longopt(name, name_length);
+    const char* longopt_name;
+
+    if (index->hot != NULL)
+    {
+        return lookup_hot_longopt(index, name, name_length, hash);
+    }
+    for (size_t slot = hash & index->long_mask; index->long_options[slot] != -1; slot = (slot + 1) & index->long_mask)
+    {
+        STATS_ADD(entries_compared, 1);
+        if (index->long_hashes[slot] != hash)
+        {
+            continue;
+        }
+        STATS_ADD(string_compares, 1);
+        longopt_name = index->options[index->long_options[slot]].longopt_name;
+        if (!strncmp(longopt_name, name, name_length) && longopt_name[name_length] == '\0')
+        {
+            return index->long_options[slot];
+        }
+    }
+    return -1;
+}
+
+typedef struct {
+    const char* name;
+    int option;
+} Named_Option;
+
+// A node of the radix tree covers the long names sorted in [lo, hi), which all share their first depth characters
+typedef struct {
+    int depth;
+    int lo;
+    int hi;
+    int first_child;
+    int child_count;
+} Prefix_Node;
+
+static int compare_names(const void* first, const void* second)
+{
+    return strcmp(((const Named_Option*) first)->name, ((const Named_Option*) second)->name);
+}
+
+// Sort the long names and build a radix tree over them, breadth first so the children of a node are contiguous
+// and their first characters can be searched with a single memchr
+static bool build_prefix_tree(dash_Index* index, const dash_Longopt* options, int long_count)
+{
+    Named_Option* names;
+    Prefix_Node* nodes;
+    Prefix_Node* node;
+    const char* first;
+    const char* last;
+    int node_count = 1;
+    int start;
+
+    index->long_count = long_count;
+    if (long_count == 0)
+    {
+        return true;
+    }
+
+    names = malloc(long_count * sizeof(Named_Option));
+    index->long_sorted = malloc(long_count * sizeof(int));
+    // Every inner node splits its range, so there are less than two nodes per name
+    index->prefix_nodes = nodes = malloc(2 * long_count * sizeof(Prefix_Node));
+    index->prefix_labels = malloc(2 * long_count * sizeof(unsigned char));
+    if (names == NULL || index->long_sorted == NULL || nodes == NULL || index->prefix_labels == NULL)
+    {
+        free(names);
+        return false;
+    }
+
+    for (int i = 0, j = 0; j < long_count; i++)
+    {
+        if (options[i].longopt_name != NULL)
+        {
+            names[j].name = options[i].longopt_name;
+            names[j++].option = i;
+        }
+    }
+    qsort(names, long_count, sizeof(Named_Option), compare_names);
+    for (int i = 0; i < long_count; i++)
+    {
+        index->long_sorted[i] = names[i].option;
+    }
+
+    nodes[0].lo = 0;
+    nodes[0].hi = long_count;
+    index->prefix_labels[0] = '\0';
+    for (int current = 0; current < node_count; current++)
+    {
+        node = &nodes[current];
+
+        // The names of a sorted range share the prefix of the first and the last one
+        first = names[node->lo].name;
+        last = names[node->hi - 1].name;
+        node->depth = 0;
+        while (first[node->depth] != '\0' && first[node->depth] == last[node->depth])
+        {
+            node->depth++;
+        }
+
+        // A name that ends here sorts first, it has no child
+        start = first[node->depth] == '\0' ? node->lo + 1 : node->lo;
+        node->first_child = node_count;
+        node->child_count = 0;
+        for (int i = start; i < node->hi; i++)
+        {
+            if (i == start || names[i].name[node->depth] != names[i - 1].name[node->depth])
+            {
+                if (i != start)
+                {
+                    nodes[node_count - 1].hi = i;
+                }
+                nodes[node_count].lo = i;
+                index->prefix_labels[node_count] = (unsigned char) names[i].name[node->depth];
+                node_count++;
+                node->child_count++;
+            }
+        }
+        if (node->child_count > 0)
+        {
+            nodes[node_count - 1].hi = node->hi;
+        }
+    }
+
+    free(names);
+    return true;
+}
+
+// Find the long names starting with the name_length first characters of name, as a range of index->long_sorted
+static int lookup_prefix(const dash_Index* index, const char* name, size_t name_length, int* lo)
+{
+    const Prefix_Node* nodes = index->prefix_nodes;
+    const Prefix_Node* node = nodes;
+    const unsigned char* child;
+    const char* representative;
+    size_t checked = 0;
+    size_t limit;
+
+    if (index->long_count == 0)
+    {
+        return 0;
+    }
+    while (true)
+    {
+        // The characters skipped by the path compression still have to match
+        representative = index->options[index->long_sorted[node->lo]].longopt_name;
+        limit = name_length < (size_t) node->depth ? name_length : (size_t) node->depth;
+        STATS_ADD(entries_compared, 1);
+        STATS_ADD(string_compares, checked < limit);
+        if (checked < limit && memcmp(&representative[checked], &name[checked], limit - checked))
+        {
+            return 0;
+        }
+        if (name_length <= (size_t) node->depth)
+        {
+            *lo = node->lo;
+            return node->hi - node->lo;
+        }
+        checked = node->depth;
+
+        child = memchr(&index->prefix_labels[node->first_child], (unsigned char) name[checked], node->child_count);
+        if (child == NULL)
+        {
+            return 0;
+        }
+        node = &nodes[child - index->prefix_labels];
+    }
+}
+
+// Value of options given without their optional parameter, never written to
+static char empty_value[] = "";
+
+typedef enum {
+    MATCH_OPTION,
+    MATCH_POSITIONAL,
+    MATCH_END,
+    MATCH_ERROR
+} Match_Kind;
+
+typedef struct {
+    Match_Kind kind;
+    int option_index;
+    char* value;
+    bool unset;
+    int argument_index;
+} Match;
+
+// Reading position in argv, shared by every way of consuming matches
+typedef struct {
+    const dash_Longopt* options;
+    int structure_length;
+    const dash_Index* index;
+    dash_Error* error;
+    int argc;
+    char** argv;
+    unsigned flags;
+    int argument;
+    int position;
+    // Offset of the '=' of the current long option, or of its terminator
+    size_t equal;
+    bool unset;
+    bool ended;
+} Cursor;
+
+static bool report_error(dash_Error* error, dash_Error_Code code, int option_index)
+{
+    // Keep the first, most precise error
+    if (error != NULL && error->code == DASH_ERROR_NONE)
+    {
+        error->code = code;
+        error->option_index = option_index;
+    }
+    return false;
+}
+
+static bool report_argument(dash_Error* error, int argument_index, const char* argument)
+{
+    if (error != NULL && error->argument_index == -1)
+    {
+        error->argument_index = argument_index;
+        error->argument = argument;
+    }
+    return false;
+}
+
+static void clear_error(dash_Error* error)
+{
+    if (error != NULL)
+    {
+        error->code = DASH_ERROR_NONE;
+        error->option_index = -1;
+        error->argument_index = -1;
+        error->argument = NULL;
+        error->candidates = NULL;
+        error->candidate_count = 0;
+        error->suggestion = -1;
+        error->line = 0;
+        error->column = 0;
+        error->constraint = -1;
+    }
+}
+
+static void cursor_init(Cursor* cursor, const dash_Longopt* options, int structure_length, const dash_Index* index, unsigned flags, dash_Error* error, int argc, char** argv)
+{
+    cursor->options = options;
+    cursor->flags = flags;
+    cursor->structure_length = structure_length;
+    cursor->index = index;
+    cursor->error = error;
+    cursor->argc = argc;
+    cursor->argv = argv;
+    cursor->argument = 1;
+    cursor->position = 0;
+    cursor->unset = false;
+    cursor->ended = false;
+}
+
+static bool match_error(Cursor* cursor, Match* match, dash_Error_Code code, int option_index, int argument_index)
+{
+    report_error(cursor->error, code, option_index);
+    report_argument(cursor->error, argument_index, argument_index < cursor->argc ? cursor->argv[argument_index] : NULL);
+    match->kind = MATCH_ERROR;
+    // Stay on the error
+    cursor->argument = cursor->argc;
+    cursor->position = 0;
+    return false;
+}
+
+static int find_shortopt(const Cursor* cursor, char name)
+{
+    if (cursor->index != NULL)
+    {
+        return cursor->index->short_options[(unsigned char) name];
+    }
+
+    // Search through all allowed arguments
+    for (int i = 0; i < cursor->structure_length; i++)
+    {
+        STATS_ADD(entries_compared, 1);
+        // Check if argument is what we want
+        if (cursor->options[i].opt_name != '\0' && name == cursor->options[i].opt_name)
+        {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// Find the only long name starting with the name of "--name" or "--name=value". With an index the candidates are a
+// range of the sorted names, found in the radix tree, without one every name is compared
+static int find_abbreviation(const Cursor* cursor, const char* name, size_t name_length, dash_Error_Code* code)
+{
+    bool with_equal = name[name_length] == '=';
+    int found = -1;
+    int count = 0;
+    int lo;
+
+    if (cursor->index != NULL)
+    {
+        count = lookup_prefix(cursor->index, name, name_length, &lo);
+        if (count == 1)
+        {
+            return cursor->index->long_sorted[lo];
+        }
+    }
+    else
+    {
+        for (int i = 0; i < cursor->structure_length; i++)
+        {
+            STATS_ADD(entries_compared, 1);
+            STATS_ADD(string_compares, cursor->options[i].longopt_name != NULL);
+            if (cursor->options[i].longopt_name != NULL && !strncmp(cursor->options[i].longopt_name, name, name_length))
+            {
+                found = i;
+                count++;
+            }
+        }
+        // Same rule as exact names, a value after '=' can only go to an option with a parameter
+        if (count == 1 && with_equal && cursor->options[found].param_name == NULL)
+        {
+            *code = DASH_ERROR_UNEXPECTED_ARGUMENT;
+            return -1;
+        }
+        if (count == 1)
+        {
+            return found;
+        }
+    }
+
+    if (count > 1)
+    {
+        *code = DASH_ERROR_AMBIGUOUS_OPTION;
+        if (cursor->error != NULL && cursor->error->code == DASH_ERROR_NONE)
+        {
+            // Without an index there is no sorted list to point into, so no candidate is reported
+            cursor->error->candidates = cursor->index != NULL ? &cursor->index->long_sorted[lo] : NULL;
+            cursor->error->candidate_count = cursor->index != NULL ? count : 0;
+        }
+    }
+    return -1;
+}
+
+// Find the option named by "--name" or "--name=value" in the current argument, with_equal is set if there is a '='
+static int find_longopt(const Cursor* cursor, const char* name, bool* with_equal, dash_Error_Code* code)
+{
+    // The offset comes from the scan of the whole argument, "--" included
+    size_t name_length = cursor->equal - 2;
+    int found;
+
+    *with_equal = name[name_length] == '=';
+    *code = DASH_ERROR_UNKNOWN_OPTION;
+
+    if (cursor->index != NULL)
+    {
+        // Names are unique and contain no '=', so a single lookup of the part before '=' is enough
+        found = lookup_longopt(cursor->index, name, name_length);
+        if (found == -1 && (cursor->flags & DASH_ABBREVIATIONS))
+        {
+            found = find_abbreviation(cursor, name, name_length, code);
+        }
+        if (found != -1 && *with_equal && cursor->options[found].param_name == NULL)
+        {
+            *code = DASH_ERROR_UNEXPECTED_ARGUMENT;
+            return -1;
+        }
+        return found;
+    }
+
+    // Search through all allowed arguments
+    for (int i = 0; i < cursor->structure_length; i++)
+    {
+        STATS_ADD(entries_compared, 1);
+        if (cursor->options[i].longopt_name == NULL)
+        {
+            continue;
+        }
+
+        // Check if argument is longopt with ' ' delimiter
+        STATS_ADD(string_compares, 1);
+        if (!strcmp(cursor->options[i].longopt_name, name))
+        {
+            *with_equal = false;
+            return i;
+        }
+
+        // Check if argument is longopt with '=' delimiter, like the index a flag given a value is reported as such
+        STATS_ADD(string_compares, *with_equal);
+        if (*with_equal && !strncmp(cursor->options[i].longopt_name, name, name_length) && cursor->options[i].longopt_name[name_length] == '\0')
+        {
+            if (cursor->options[i].param_name == NULL)
+            {
+                *code = DASH_ERROR_UNEXPECTED_ARGUMENT;
+                return -1;
+            }
+            return i;
+        }
+    }
+    if (cursor->flags & DASH_ABBREVIATIONS)
+    {
+        return find_abbreviation(cursor, name, name_length, code);
+    }
+    return -1;
+}
+
+// Bigrams of a name hashed into the bits of a word, only used to rule out names that can't be close
+static uint64_t bigram_signature(const char* name, size_t length)
+{
+    uint64_t signature = 0;
+
+    for (size_t i = 1; i < length; i++)
+    {
+        signature |= (uint64_t) 1 << (((unsigned char) name[i - 1] * 31u + (unsigned char) name[i]) & 63);
+    }
+    return signature;
+}
+
+static int count_bits(uint64_t bits)
+{
+    int count = 0;
+
+    for (; bits != 0; bits &= bits - 1)
+    {
+        count++;
+    }
+    return count;
+}
+
+// Levenshtein distance between name and the pattern whose character masks are in peq, with Myers' bit-parallel
+// algorithm in Hyyrö's formulation for a whole string, one step per character of name for patterns of up to
+// 64 characters. Gives up with limit + 1 as soon as the rest of name can't bring the distance down to limit
+static int edit_distance(const uint64_t peq[256], size_t pattern_length, const char* name, size_t name_length, int limit)
+{
+    uint64_t high = (uint64_t) 1 << (pattern_length - 1);
+    uint64_t vp = ~(uint64_t) 0;
+    uint64_t vn = 0;
+    uint64_t eq, xv, xh, ph, mh;
+    int distance = (int) pattern_length;
+
+    for (size_t i = 0; i < name_length; i++)
+    {
+        eq = peq[(unsigned char) name[i]];
+        xv = eq | vn;
+        xh = (((eq & vp) + vp) ^ vp) | eq;
+        ph = vn | ~(xh | vp);
+        mh = vp & xh;
+        distance += (ph & high) ? 1 : (mh & high) ? -1 : 0;
+        // The first row of the matrix grows by one per character
+        ph = (ph << 1) | 1;
+        mh <<= 1;
+        vp = mh | ~(xv | ph);
+        vn = ph & xv;
+        if (distance - (int) (name_length - i - 1) > limit)
+        {
+            return limit + 1;
+        }
+    }
+    return distance;
+}
+
+// Find the long name closest to an unknown one for the error, only on the error path. Names are ruled out by their
+// bigrams first, from the index when there is one: an edit changes at most two of them, so a name with more than
+// twice the limit of bigrams missing from the other can't be close enough. Then by their length, and only the rest
+// go through the distance
+static void suggest_longopt(const Cursor* cursor, const char* name, size_t name_length)
+{
+    const uint64_t* signatures = cursor->index != NULL ? cursor->index->long_signatures : NULL;
+    uint64_t peq[256] = {0};
+    uint64_t signature;
+    uint64_t candidate_signature;
+    const char* candidate;
+    size_t candidate_length;
+    int limit;
+    int distance;
+
+    if (cursor->error == NULL || cursor->error->code != DASH_ERROR_NONE || name_length == 0 || name_length > 64)
+    {
+        return;
+    }
+    // One typo in short names, up to three in long ones
+    limit = 1 + (int) name_length / 4;
+    limit = limit > 3 ? 3 : limit;
+    for (size_t i = 0; i < name_length; i++)
+    {
+        peq[(unsigned char) name[i]] |= (uint64_t) 1 << i;
+    }
+    signature = bigram_signature(name, name_length);
+
+    for (int i = 0; i < cursor->structure_length; i++)
+    {
+        candidate = cursor->options[i].longopt_name;
+        STATS_ADD(entries_compared, 1);
+        if (candidate == NULL)
+        {
+            continue;
+        }
+        candidate_length = signatures != NULL ? 0 : strlen(candidate);
+        candidate_signature = signatures != NULL ? signatures[i] : bigram_signature(candidate, candidate_length);
+        if (count_bits(signature & ~candidate_signature) > 2 * limit || count_bits(candidate_signature & ~signature) > 2 * limit)
+        {
+            continue;
+        }
+        candidate_length = signatures != NULL ? strlen(candidate) : candidate_length;
+        if ((candidate_length > name_length ? candidate_length - name_length : name_length - candidate_length) > (size_t) limit)
+        {
+            continue;
+        }
+        STATS_ADD(string_compares, 1);
+        distance = edit_distance(peq, name_length, candidate, candidate_length, limit);
+        if (distance <= limit)
+        {
+            // Ties go to the first name of the table, only a closer one can replace it
+            cursor->error->suggestion = i;
+            limit = distance - 1;
+            if (limit < 0)
+            {
+                break;
+            }
+        }
+    }
+}
+
+// The option at match->option_index takes its value from the next argument
+static bool match_next_value(Cursor* cursor, Match* match)
+{
+    const dash_Longopt* option = &cursor->options[match->option_index];
+
+    // Errors while storing the value point at the argument after the option
+    match->argument_index = cursor->argument;
+    if (cursor->argument < cursor->argc && cursor->argv[cursor->argument][0] != '-')
+    {
+        STATS_ADD(tokens, 1);
+        match->value = cursor->argv[cursor->argument++];
+        return true;
+    }
+    if (!option->param_optional)
+    {
+        return match_error(cursor, match, DASH_ERROR_MISSING_ARGUMENT, match->option_index, cursor->argument);
+    }
+    match->value = empty_value;
+    return true;
+}
+
+// Read the next option or positional argument
+static bool next_match(Cursor* cursor, Match* match)
+{
+    const dash_Longopt* option;
+    char* token;
+    dash_Error_Code code;
+    bool with_equal;
+    bool attached;
+
+    while (true)
+    {
+        // Inside a cluster of short options
+        if (cursor->position > 0)
+        {
+            token = cursor->argv[cursor->argument];
+            if (token[cursor->position] == '\0')
+            {
+                cursor->argument++;
+                cursor->position = 0;
+                continue;
+            }
+
+            match->kind = MATCH_OPTION;
+            match->argument_index = cursor->argument;
+            match->unset = cursor->unset;
+            match->value = NULL;
+            if ((match->option_index = find_shortopt(cursor, token[cursor->position])) == -1)
+            {
+                // Maybe a long name written with a single dash
+                if (token[0] == '-' && token[2] != '\0')
+                {
+                    suggest_longopt(cursor, &token[1], strcspn(&token[1], "="));
+                }
+                return match_error(cursor, match, DASH_ERROR_UNKNOWN_OPTION, -1, cursor->argument);
+            }
+            option = &cursor->options[match->option_index];
+            if (cursor->unset && !option->allow_flag_unset)
+            {
+                return match_error(cursor, match, DASH_ERROR_UNSET_NOT_ALLOWED, match->option_index, cursor->argument);
+            }
+            cursor->position++;
+            if (option->param_name == NULL)
+            {
+                return true;
+            }
+
+            // The rest of the cluster is the value of a required parameter after '-', of an optional one after '+'
+            attached = cursor->unset ? option->param_optional : !option->param_optional;
+            if (token[cursor->position] == '\0')
+            {
+                cursor->argument++;
+                cursor->position = 0;
+                return match_next_value(cursor, match);
+            }
+            if (attached)
+            {
+                match->value = &token[cursor->position];
+                cursor->argument++;
+                cursor->position = 0;
+                return true;
+            }
+            // Not the last option of the cluster, it doesn't get any value
+            continue;
+        }
+
+        if (cursor->argument >= cursor->argc)
+        {
+            match->kind = MATCH_END;
+            return true;
+        }
+
+        token = cursor->argv[cursor->argument];
+        match->argument_index = cursor->argument;
+        STATS_ADD(tokens, 1);
+
+        // Anything after a double dash, anything not beginning with a dash or a plus, and single dashes (will be used as stdin)
+        if (cursor->ended || (token[0] != '-' && token[0] != '+') || (token[0] == '-' && token[1] == '\0'))
+        {
+            match->kind = MATCH_POSITIONAL;
+            match->value = token;
+            cursor->argument++;
+            return true;
+        }
+
+        // Short opt, set with a dash or unset with a plus
+        if (token[0] == '+' || token[1] != '-')
+        {
+            cursor->unset = token[0] == '+';
+            cursor->position = 1;
+            continue;
+        }
+
+        // Only double dash, end of parsing arguments
+        if (token[2] == '\0')
+        {
+            cursor->ended = true;
+            cursor->argument++;
+            continue;
+        }
+
+        // Long opt, the name stops at the first '=', the value isn't read
+        cursor->equal = scan_token(token, '=');
+        match->kind = MATCH_OPTION;
+        match->unset = false;
+        match->value = NULL;
+        if ((match->option_index = find_longopt(cursor, &token[2], &with_equal, &code)) == -1)
+        {
+            if (code == DASH_ERROR_UNKNOWN_OPTION)
+            {
+                suggest_longopt(cursor, &token[2], cursor->equal - 2);
+            }
+            return match_error(cursor, match, code, -1, cursor->argument);
+        }
+        cursor->argument++;
+        if (cursor->options[match->option_index].param_name == NULL)
+        {
+            return true;
+        }
+        if (!with_equal)
+        {
+            return match_next_value(cursor, match);
+        }
+        if (token[cursor->equal + 1] == '\0')
+        {
+            return match_error(cursor, match, DASH_ERROR_MISSING_ARGUMENT, match->option_index, match->argument_index);
+        }
+        match->value = &token[cursor->equal + 1];
+        return true;
+    }
+}
+
+// Decimal digits, without sign, into a 64 bits unsigned integer
+static dash_Error_Code parse_digits(const char** text, uint64_t* value)
+{
+    const char* cursor = *text;
+    unsigned digit;
+
+    *value = 0;
+    if (*cursor < '0' || *cursor > '9')
+    {
+        return DASH_ERROR_INVALID_VALUE;
+    }
+    while (*cursor >= '0' && *cursor <= '9')
+    {
+        digit = (unsigned) (*cursor++ - '0');
+        if (*value > (UINT64_MAX - digit) / 10)
+        {
+            return DASH_ERROR_OUT_OF_RANGE;
+        }
+        *value = *value * 10 + digit;
+    }
+    *text = cursor;
+    return DASH_ERROR_NONE;
+}
+
+static dash_Error_Code parse_int64(const char* text, int64_t* value)
+{
+    bool negative = *text == '-';
+    dash_Error_Code code;
+    uint64_t magnitude;
+
+    if (*text == '-' || *text == '+')
+    {
+        text++;
+    }
+    if ((code = parse_digits(&text, &magnitude)) != DASH_ERROR_NONE)
+    {
+        return code;
+    }
+    if (*text != '\0')
+    {
+        return DASH_ERROR_INVALID_VALUE;
+    }
+    if (magnitude > (uint64_t) INT64_MAX + negative)
+    {
+        return DASH_ERROR_OUT_OF_RANGE;
+    }
+    // Negate as unsigned so INT64_MIN doesn't overflow
+    *value = negative ? (int64_t) (0 - magnitude) : (int64_t) magnitude;
+    return DASH_ERROR_NONE;
+}
+
+static dash_Error_Code parse_uint64(const char* text, uint64_t* value)
+{
+    dash_Error_Code code;
+
+    if (*text == '+')
+    {
+        text++;
+    }
+    if ((code = parse_digits(&text, value)) != DASH_ERROR_NONE)
+    {
+        return code;
+    }
+    return *text == '\0' ? DASH_ERROR_NONE : DASH_ERROR_INVALID_VALUE;
+}
+
+// An integer followed by one of the units, the unit is required when there is no unit named ""
+static dash_Error_Code parse_with_unit(const char* text, const char* const units[], const uint64_t multipliers[], uint64_t* value)
+{
+    dash_Error_Code code;
+
+    if ((code = parse_digits(&text, value)) != DASH_ERROR_NONE)
+    {
+        return code;
+    }
+    for (int i = 0; units[i] != NULL; i++)
+    {
+        if (!strcmp(text, units[i]))
+        {
+            if (*value > UINT64_MAX / multipliers[i])
+            {
+                return DASH_ERROR_OUT_OF_RANGE;
+            }
+            *value *= multipliers[i];
+            return DASH_ERROR_NONE;
+        }
+    }
+    return DASH_ERROR_INVALID_VALUE;
+}
+
+// Only locale-independent path of the C library for the values the fast path can't convert exactly
+static dash_Error_Code parse_double_slow(const char* text, double* value)
+{
+    char* end;
+
+    #if defined(_WIN32) || defined(WIN32)
+        static volatile _locale_t numeric_locale = NULL;
+        _locale_t locale = numeric_locale;
+
+        if (locale == NULL)
+        {
+            // Falling back to strtod would read the value in the user's locale
+            if ((locale = _create_locale(LC_NUMERIC, "C")) == NULL)
+            {
+                return DASH_ERROR_OUT_OF_MEMORY;
+            }
+            // Another thread may have created it first
+            if (InterlockedCompareExchangePointer((PVOID volatile*) &numeric_locale, locale, NULL) != NULL)
+            {
+                _free_locale(locale);
+                locale = numeric_locale;
+            }
+        }
+        *value = _strtod_l(text, &end, locale);
+    #else
+        static locale_t numeric_locale = (locale_t) 0;
+        locale_t locale = __atomic_load_n(&numeric_locale, __ATOMIC_ACQUIRE);
+        locale_t expected = (locale_t) 0;
+        locale_t previous;
+
+        if (locale == (locale_t) 0)
+        {
+            // uselocale((locale_t) 0) would only query the current locale and strtod would follow it
+            if ((locale = newlocale(LC_NUMERIC_MASK, "C", (locale_t) 0)) == (locale_t) 0)
+            {
+                return DASH_ERROR_OUT_OF_MEMORY;
+            }
+            // Another thread may have created it first
+            if (!__atomic_compare_exchange_n(&numeric_locale, &expected, locale, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+            {
+                freelocale(locale);
+                locale = expected;
+            }
+        }
+        // Switches the calling thread only
+        previous = uselocale(locale);
+        *value = strtod(text, &end);
+        uselocale(previous);
+    #endif
+
+    if (*end != '\0')
+    {
+        return DASH_ERROR_INVALID_VALUE;
+    }
+    if (*value > DBL_MAX || *value < -DBL_MAX)
+    {
+        return DASH_ERROR_OUT_OF_RANGE;
+    }
+    return DASH_ERROR_NONE;
+}
+
+// Clinger's fast path: a mantissa that fits a double exactly, scaled by an exact power of ten, is rounded only once
+static dash_Error_Code parse_double(const char* text, double* value)
+{
+    static const double powers_of_ten[] = {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+    };
+    const char* cursor = text;
+    bool negative = false;
+    bool exponent_negative = false;
+    bool truncated = false;
+    uint64_t mantissa = 0;
+    int digit_count = 0;
+    int exponent = 0;
+    int explicit_exponent = 0;
+
+    if (*cursor == '-' || *cursor == '+')
+    {
+        negative = *cursor++ == '-';
+    }
+    for (; *cursor >= '0' && *cursor <= '9'; cursor++, digit_count++)
+    {
+        if (mantissa < 1000000000000000000u)
+        {
+            mantissa = mantissa * 10 + (uint64_t) (*cursor - '0');
+        }
+        else
+        {
+            truncated = true;
+            exponent++;
+        }
+    }
+    if (*cursor == '.')
+    {
+        for (cursor++; *cursor >= '0' && *cursor <= '9'; cursor++, digit_count++)
+        {
+            if (mantissa < 1000000000000000000u)
+            {
+                mantissa = mantissa * 10 + (uint64_t) (*cursor - '0');
+                exponent--;
+            }
+            else
+            {
+                truncated = true;
+            }
+        }
+    }
+    if (digit_count == 0)
+    {
+        return DASH_ERROR_INVALID_VALUE;
+    }
+    if (*cursor == 'e' || *cursor == 'E')
+    {
+        cursor++;
+        if (*cursor == '-' || *cursor == '+')
+        {
+            exponent_negative = *cursor++ == '-';
+        }
+        if (*cursor < '0' || *cursor > '9')
+        {
+            return DASH_ERROR_INVALID_VALUE;
+        }
+        for (; *cursor >= '0' && *cursor <= '9'; cursor++)
+        {
+            // Anything past this is out of range or zero anyway
+            if (explicit_exponent < 100000)
+            {
+                explicit_exponent = explicit_exponent * 10 + (*cursor - '0');
+            }
+        }
+        exponent += exponent_negative ? -explicit_exponent : explicit_exponent;
+    }
+    if (*cursor != '\0')
+    {
+        return DASH_ERROR_INVALID_VALUE;
+    }
+
+    if (!truncated && mantissa <= (uint64_t) 1 << 53 && exponent >= -22 && exponent <= 22)
+    {
+        *value = exponent < 0 ? (double) mantissa / powers_of_ten[-exponent] : (double) mantissa * powers_of_ten[exponent];
+        if (negative)
+        {
+            *value = -*value;
+        }
+        return DASH_ERROR_NONE;
+    }
+
+    return parse_double_slow(text, value);
+}
+
+// Counters take no parameter, every other type needs one
+static bool valid_type(const dash_Longopt* option)
+{
+    if (option->type == DASH_TYPE_STRING)
+    {
+        return true;
+    }
+    return (option->type == DASH_TYPE_COUNT) == (option->param_name == NULL);
+}
+
+static bool holds_string(const dash_Longopt* option)
+{
+    return option->param_name != NULL && option->type == DASH_TYPE_STRING;
+}
+
+// Convert the value of a typed option, an optional value that was left out converts to 0
+static dash_Error_Code convert_value(const dash_Longopt* option, const char* value, dash_Number* number)
+{
+    static const char* const size_units[] = {"", "K", "M", "G", NULL};
+    static const uint64_t size_multipliers[] = {1, (uint64_t) 1 << 10, (uint64_t) 1 << 20, (uint64_t) 1 << 30};
+    static const char* const duration_units[] = {"ms", "s", "m", NULL};
+    static const uint64_t duration_multipliers[] = {1, 1000, 60000};
+
+    number->uint64 = 0;
+    if (value[0] == '\0' && option->param_optional)
+    {
+        return DASH_ERROR_NONE;
+    }
+    switch (option->type)
+    {
+        case DASH_TYPE_INT64:
+            return parse_int64(value, &number->int64);
+        case DASH_TYPE_UINT64:
+            return parse_uint64(value, &number->uint64);
+        case DASH_TYPE_DOUBLE:
+            return parse_double(value, &number->real);
+        case DASH_TYPE_SIZE:
+            return parse_with_unit(value, size_units, size_multipliers, &number->uint64);
+        case DASH_TYPE_DURATION:
+            return parse_with_unit(value, duration_units, duration_multipliers, &number->uint64);
+        case DASH_TYPE_STRING:
+        case DASH_TYPE_LIST:
+        case DASH_TYPE_COUNT:
+            break;
+    }
+    return DASH_ERROR_NONE;
+}
+
+static void write_number(const dash_Longopt* option, const dash_Number* number)
+{
+    switch (option->type)
+    {
+        case DASH_TYPE_INT64:
+            *((int64_t*) option->user_pointer) = number->int64;
+            break;
+        case DASH_TYPE_DOUBLE:
+            *((double*) option->user_pointer) = number->real;
+            break;
+        case DASH_TYPE_UINT64:
+        case DASH_TYPE_SIZE:
+        case DASH_TYPE_DURATION:
+            *((uint64_t*) option->user_pointer) = number->uint64;
+            break;
+        case DASH_TYPE_STRING:
+        case DASH_TYPE_LIST:
+        case DASH_TYPE_COUNT:
+            break;
+    }
+}
+
+static void* arena_allocate(dash_Arena* arena, size_t size)
+{
+    size_t capacity;
+    void** block;
+    void* allocation;
+
+    if (arena->size - arena->used < size)
+    {
+        // A caller-supplied buffer can't grow
+        if (!arena->growable)
+        {
+            return NULL;
+        }
+        capacity = arena->size * 2;
+        if (capacity < size)
+        {
+            capacity = size;
+        }
+        if (capacity < 4096)
+        {
+            capacity = 4096;
+        }
+
+        // Blocks are chained through their first pointer so they can all be released at once
+        block = malloc(sizeof(void*) + capacity);
+        STATS_ADD(allocations, 1);
+        if (block == NULL)
+        {
+            return NULL;
+        }
+        *block = arena->blocks;
+        arena->blocks = block;
+        arena->buffer = (char*) (block + 1);
+        arena->size = capacity;
+        arena->used = 0;
+    }
+
+    allocation = &arena->buffer[arena->used];
+    arena->used += size;
+    return allocation;
+}
+
+static bool list_append(dash_List* list, char* value)
+{
+    char** grown;
+
+    // Doubling keeps appends amortized constant and the values contiguous
+    if (list->count == list->capacity)
+    {
+        grown = realloc(list->values, (list->capacity * 2 + 8) * sizeof(char*));
+        STATS_ADD(allocations, 1);
+        if (grown == NULL)
+        {
+            return false;
+        }
+        list->values = grown;
+        list->capacity = list->capacity * 2 + 8;
+    }
+    list->values[list->count++] = value;
+    return true;
+}
+
+// Copy a value into the arena or the heap, or point into argv for DASH_ZERO_COPY
+static bool copy_value(const dash_Longopt* options, int option_index, char* value, bool unset, const dash_Settings* settings, char** destination)
+{
+    const dash_Longopt* option = &options[option_index];
+    size_t value_length;
+
+    // Point straight into argv, the polarity is only reported through unset_pointer
+    if (settings->flags & DASH_ZERO_COPY)
+    {
+        *destination = value;
+        return true;
+    }
+
+    value_length = scan_token(value, '\0');
+    if (settings->arena != NULL)
+    {
+        *destination = arena_allocate(settings->arena, (value_length + option->allow_flag_unset + 1) * sizeof(char));
+        if (*destination == NULL)
+        {
+            return report_error(settings->error, settings->arena->growable ? DASH_ERROR_OUT_OF_MEMORY : DASH_ERROR_ARENA_FULL, option_index);
+        }
+    }
+    else
+    {
+        *destination = malloc((value_length + option->allow_flag_unset + 1) * sizeof(char));
+        STATS_ADD(allocations, 1);
+        if (*destination == NULL)
+        {
+            return report_error(settings->error, DASH_ERROR_OUT_OF_MEMORY, option_index);
+        }
+    }
+    if (option->allow_flag_unset)
+    {
+        (*destination)[0] = unset ? '+' : '-';
+    }
+    memcpy(&(*destination)[option->allow_flag_unset], value, value_length + 1);
+    STATS_ADD(bytes_copied, value_length + option->allow_flag_unset + 1);
+    return true;
+}
+
+static bool store_value(const dash_Longopt* options, int option_index, char* value, bool unset, const dash_Settings* settings)
+{
+    const dash_Longopt* option = &options[option_index];
+    char** destination = (char**) option->user_pointer;
+    dash_List* list = (dash_List*) option->user_pointer;
+    dash_Error_Code code;
+    dash_Number number;
+    char* copy;
+
+    if (option->unset_pointer != NULL && (option->type != DASH_TYPE_STRING || *destination == NULL))
+    {
+        *option->unset_pointer = unset;
+    }
+
+    // Every value is kept, in the order they were given
+    if (option->type == DASH_TYPE_LIST)
+    {
+        if (!copy_value(options, option_index, value, unset, settings, &copy))
+        {
+            return false;
+        }
+        if (!list_append(list, copy))
+        {
+            if (!(settings->flags & DASH_ZERO_COPY) && settings->arena == NULL)
+            {
+                free(copy);
+            }
+            return report_error(settings->error, DASH_ERROR_OUT_OF_MEMORY, option_index);
+        }
+        return true;
+    }
+
+    // Numbers are converted straight into the user's storage, the last one given wins
+    if (option->type != DASH_TYPE_STRING)
+    {
+        if ((code = convert_value(option, value, &number)) != DASH_ERROR_NONE)
+        {
+            return report_error(settings->error, code, option_index);
+        }
+        write_number(option, &number);
+        return true;
+    }
+
+    // A non-boolean flag can only be set once
+    if (*destination != NULL)
+    {
+        return report_error(settings->error, DASH_ERROR_ALREADY_SET, option_index);
+    }
+    return copy_value(options, option_index, value, unset, settings, destination);
+}
+
+// Options without a parameter, booleans or counters
+static void store_flag(const dash_Longopt* option, bool unset)
+{
+    if (option->type == DASH_TYPE_COUNT)
+    {
+        // +v starts over, like it turns a boolean off
+        *((int*) option->user_pointer) = unset ? 0 : *((int*) option->user_pointer) + 1;
+        return;
+    }
+    *((bool*) option->user_pointer) = !unset;
+}
+
+// Marks the options given on the command line in a table of fallback values, which then can't override them
+static char given_on_command_line[] = "";
+
+// Text of a boolean in the environment, compared without the locale
+static dash_Error_Code parse_flag(const char* text, bool* value)
+{
+    static const struct {const char* name; bool value;} names[] = {
+        {"1", true}, {"true", true}, {"yes", true}, {"on", true},
+        {"", false}, {"0", false}, {"false", false}, {"no", false}, {"off", false},
+    };
+    char lowered[8];
+    size_t length = 0;
+
+    while (text[length] != '\0' && length < sizeof(lowered) - 1)
+    {
+        lowered[length] = text[length] >= 'A' && text[length] <= 'Z' ? (char) (text[length] - 'A' + 'a') : text[length];
+        length++;
+    }
+    lowered[length] = '\0';
+    if (text[length] != '\0')
+    {
+        return DASH_ERROR_INVALID_VALUE;
+    }
+    for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); i++)
+    {
+        if (!strcmp(lowered, names[i].name))
+        {
+            *value = names[i].value;
+            return DASH_ERROR_NONE;
+        }
+    }
+    return DASH_ERROR_INVALID_VALUE;
+}
+
+// Value of an option without a parameter taken from text, a boolean or a counter
+static dash_Error_Code convert_flag(const dash_Longopt* option, const char* text, dash_Number* number)
+{
+    dash_Error_Code code;
+    bool flag;
+
+    number->uint64 = 0;
+    if (option->type == DASH_TYPE_COUNT)
+    {
+        if ((code = parse_uint64(text, &number->uint64)) == DASH_ERROR_NONE && number->uint64 > INT32_MAX)
+        {
+            return DASH_ERROR_OUT_OF_RANGE;
+        }
+        number->int64 = (int64_t) number->uint64;
+        return code;
+    }
+    if ((code = parse_flag(text, &flag)) == DASH_ERROR_NONE)
+    {
+        number->int64 = flag;
+    }
+    return code;
+}
+
+// Fill the fallback value of every option with an env_name that wasn't given on the command line,
+// with a single pass over the environment against a hash set of the wanted names
+static bool collect_environment(const dash_Longopt* options, int structure_length, char** fallback)
+{
+    int small_table[128];
+    int* table = small_table;
+    size_t table_size = 1;
+    size_t mask;
+    size_t slot;
+    size_t name_length;
+    unsigned hash;
+    int wanted = 0;
+    int option;
+
+    for (int i = 0; i < structure_length; i++)
+    {
+        wanted += options[i].env_name != NULL && fallback[i] == NULL;
+    }
+    if (wanted == 0)
+    {
+        return true;
+    }
+
+    while (table_size < 2 * (size_t) wanted + 1)
+    {
+        table_size <<= 1;
+    }
+    if (table_size > sizeof(small_table) / sizeof(int))
+    {
+        table = malloc(table_size * sizeof(int));
+        if (table == NULL)
+        {
+            return false;
+        }
+    }
+    mask = table_size - 1;
+    for (size_t i = 0; i < table_size; i++)
+    {
+        table[i] = -1;
+    }
+    for (int i = 0; i < structure_length; i++)
+    {
+        if (options[i].env_name != NULL && fallback[i] == NULL)
+        {
+            hash = hash_longopt(options[i].env_name, strlen(options[i].env_name));
+            for (slot = hash & mask; table[slot] != -1; slot = (slot + 1) & mask);
+            table[slot] = i;
+        }
+    }
+
+    for (char** entry = environ; entry != NULL && *entry != NULL && wanted > 0; entry++)
+    {
+        name_length = scan_token(*entry, '=');
+        if ((*entry)[name_length] != '=')
+        {
+            continue;
+        }
+        hash = hash_longopt(*entry, name_length);
+        for (slot = hash & mask; (option = table[slot]) != -1; slot = (slot + 1) & mask)
+        {
+            // Several options can share a variable, and only the first occurrence of a variable counts
+            if (fallback[option] == NULL && !strncmp(options[option].env_name, *entry, name_length) && options[option].env_name[name_length] == '\0')
+            {
+                fallback[option] = &(*entry)[name_length + 1];
+                wanted--;
+            }
+        }
+    }
+
+    if (table != small_table)
+    {
+        free(table);
+    }
+    return true;
+}
+
+// Errors in a fallback value report the whole NAME=value entry it came from
+static const char* fallback_entry(const dash_Longopt* option, const char* value)
+{
+    return value - strlen(option->env_name) - 1;
+}
+
+// A key = value line of a configuration file, both sides '\0'-terminated in the file
+typedef struct {
+    char* key;
+    char* value;
+    int key_length;
+    int line;
+    int key_column;
+    int value_column;
+} Config_Entry;
+
+// Keys of a configuration file are long option names
+static int find_config_option(const dash_Longopt* options, int structure_length, const dash_Index* index, const Config_Entry* entry)
+{
+    if (index != NULL)
+    {
+        return lookup_longopt(index, entry->key, entry->key_length);
+    }
+    for (int i = 0; i < structure_length; i++)
+    {
+        if (options[i].longopt_name != NULL && !strcmp(options[i].longopt_name, entry->key))
+        {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static bool report_config(dash_Error* error, const Config_Entry* entry, bool on_value)
+{
+    if (error != NULL && error->line == 0)
+    {
+        error->argument = on_value ? entry->value : entry->key;
+        error->line = entry->line;
+        error->column = on_value ? entry->value_column : entry->key_column;
+    }
+    return false;
+}
+
+// Store a value that doesn't come from the command line, in the environment or in a configuration file
+static bool store_fallback(dash_Longopt* options, int option_index, char* text, const dash_Settings* settings)
+{
+    dash_Error_Code code;
+    dash_Number number;
+
+    if (options[option_index].param_name != NULL)
+    {
+        return store_value(options, option_index, text, false, settings);
+    }
+    if ((code = convert_flag(&options[option_index], text, &number)) != DASH_ERROR_NONE)
+    {
+        return report_error(settings->error, code, option_index);
+    }
+    if (options[option_index].type == DASH_TYPE_COUNT)
+    {
+        *((int*) options[option_index].user_pointer) = (int) number.int64;
+    }
+    else
+    {
+        *((bool*) options[option_index].user_pointer) = number.int64 != 0;
+    }
+    return true;
+}
+
+// Whether an option counts as given for the constraints once its value is stored: a flag or a counter turned off
+// with +X or a false value isn't
+static bool value_given(const dash_Longopt* option)
+{
+    if (option->param_name != NULL)
+    {
+        return true;
+    }
+    return option->type == DASH_TYPE_COUNT ? *((int*) option->user_pointer) != 0 : *((bool*) option->user_pointer);
+}
+
+static void set_option_bit(uint64_t* bits, int option_index, bool on)
+{
+    uint64_t bit = (uint64_t) 1 << (option_index % 64);
+
+    bits[option_index / 64] = on ? bits[option_index / 64] | bit : bits[option_index / 64] & ~bit;
+}
+
+// Only on the error path
+static int first_bit(uint64_t bits)
+{
+    int bit = 0;
+
+    while (!((bits >> bit) & 1))
+    {
+        bit++;
+    }
+    return bit;
+}
+
+static bool report_constraint(dash_Error* error, const dash_Constraints* constraints, int rule, dash_Error_Code code, int option_index)
+{
+    report_error(error, code, option_index);
+    if (error != NULL && error->constraint == -1)
+    {
+        error->constraint = rule;
+        error->argument = constraints->rules[rule].options;
+    }
+    return false;
+}
+
+// Every rule is a few word operations on the options given, the first mask of a rule holds all its options but for
+// DASH_RULE_REQUIRES, where it holds the option requiring the others of the second mask
+static bool check_constraints(const dash_Constraints* constraints, const uint64_t* given, dash_Error* error)
+{
+    int words = constraints->word_count;
+    const uint64_t* first;
+    const uint64_t* others;
+    uint64_t bits;
+    uint64_t seen;
+
+    for (int r = 0; r < constraints->rule_count; r++)
+    {
+        first = &constraints->masks[2 * (size_t) r * words];
+        others = first + words;
+        seen = 0;
+        switch (constraints->rules[r].rule)
+        {
+            case DASH_RULE_REQUIRED:
+                for (int w = 0; w < words; w++)
+                {
+                    if ((bits = first[w] & ~given[w]) != 0)
+                    {
+                        return report_constraint(error, constraints, r, DASH_ERROR_REQUIRED_OPTION, w * 64 + first_bit(bits));
+                    }
+                }
+                break;
+            case DASH_RULE_EXCLUSIVE:
+                for (int w = 0; w < words; w++)
+                {
+                    // The first option given in the order of the table is allowed, the next one is reported
+                    bits = first[w] & given[w];
+                    if (bits != 0 && seen == 0)
+                    {
+                        seen = 1;
+                        bits &= bits - 1;
+                    }
+                    if (bits != 0)
+                    {
+                        return report_constraint(error, constraints, r, DASH_ERROR_EXCLUSIVE_OPTIONS, w * 64 + first_bit(bits));
+                    }
+                }
+                break;
+            case DASH_RULE_REQUIRES:
+                for (int w = 0; w < words; w++)
+                {
+                    seen |= first[w] & given[w];
+                }
+                for (int w = 0; seen != 0 && w < words; w++)
+                {
+                    if ((others[w] & ~given[w]) != 0)
+                    {
+                        for (w = 0; first[w] == 0; w++);
+                        return report_constraint(error, constraints, r, DASH_ERROR_MISSING_DEPENDENCY, w * 64 + first_bit(first[w]));
+                    }
+                }
+                break;
+            case DASH_RULE_ONE_OF:
+                for (int w = 0; w < words; w++)
+                {
+                    seen |= first[w] & given[w];
+                }
+                if (seen == 0)
+                {
+                    return report_constraint(error, constraints, r, DASH_ERROR_ONE_REQUIRED, -1);
+                }
+                break;
+        }
+    }
+    return true;
+}
+
+static bool parse_arguments(int* argc, char* argv[], dash_Longopt* options, const dash_Settings* settings)
+{
+    int argument_non_option_count = 1;
+    int structure_length = 0;
+    int fallback_count = 0;
+    char* small_fallback[64];
+    char** fallback = NULL;
+    uint64_t small_given[4];
+    uint64_t* given = NULL;
+    const Config_Entry* entry;
+    const Hot_Index* hot = settings->index != NULL ? settings->index->hot : NULL;
+    int option;
+    Cursor cursor;
+    Match match;
+    bool ok = true;
+
+    STATS_BEGIN(DASH_PHASE_INIT);
+    clear_error(settings->error);
+
+    // A compiled table was checked when it was compiled, and resetting its values only reads its hot part. Every
+    // value is reset to zero, so the order of the groups doesn't matter even for pointers shared between options
+    if (hot != NULL && hot->values != NULL)
+    {
+        structure_length = settings->index->structure_length;
+        fallback_count = hot->fallback_count;
+        for (int i = 0; i < hot->group_ends[RESET_FLAG]; i++)
+        {
+            *((bool*) hot->values[i]) = false;
+        }
+        for (int i = hot->group_ends[RESET_FLAG]; i < hot->group_ends[RESET_COUNT]; i++)
+        {
+            *((int*) hot->values[i]) = 0;
+        }
+        for (int i = hot->group_ends[RESET_COUNT]; i < hot->group_ends[RESET_STRING]; i++)
+        {
+            *((char**) hot->values[i]) = NULL;
+        }
+        // Every number type is eight bytes wide, and zero in all of them is all bits clear
+        for (int i = hot->group_ends[RESET_STRING]; i < hot->group_ends[RESET_NUMBER]; i++)
+        {
+            memset(hot->values[i], 0, sizeof(dash_Number));
+        }
+        for (int i = hot->group_ends[RESET_NUMBER]; i < hot->group_ends[RESET_LIST]; i++)
+        {
+            *((dash_List*) hot->values[i]) = (dash_List) {0};
+        }
+        for (int i = hot->group_ends[RESET_LIST]; i < hot->group_ends[RESET_UNSET]; i++)
+        {
+            *((bool*) hot->values[i]) = false;
+        }
+    }
+
+    while ((hot == NULL || hot->values == NULL) && (options[structure_length].opt_name != '\0' || options[structure_length].longopt_name != NULL))
+    {
+        // Can't dereference a NULL pointer
+        if (options[structure_length].user_pointer == NULL || !valid_type(&options[structure_length]))
+        {
+            STATS_END(true);
+            return report_error(settings->error, DASH_ERROR_INVALID_TABLE, structure_length);
+        }
+
+        // We put each pointer to NULL so we can know if they were allocated or not int the future.
+        if (options[structure_length].type == DASH_TYPE_COUNT)
+        {
+            *((int*) options[structure_length].user_pointer) = 0;
+        }
+        else if(options[structure_length].param_name == NULL)
+        {
+            *((bool*)options[structure_length].user_pointer) = false;
+        }
+        else if (options[structure_length].type == DASH_TYPE_LIST)
+        {
+            *((dash_List*) options[structure_length].user_pointer) = (dash_List) {0};
+            if (options[structure_length].unset_pointer != NULL)
+            {
+                *options[structure_length].unset_pointer = false;
+            }
+        }
+        else if (options[structure_length].type != DASH_TYPE_STRING)
+        {
+            write_number(&options[structure_length], &(dash_Number) {0});
+            if (options[structure_length].unset_pointer != NULL)
+            {
+                *options[structure_length].unset_pointer = false;
+            }
+        }
+        else
+        {
+            *((char**)options[structure_length].user_pointer) = NULL;
+            if (options[structure_length].unset_pointer != NULL)
+            {
+                *options[structure_length].unset_pointer = false;
+            }
+        }
+        fallback_count += options[structure_length].env_name != NULL;
+        structure_length++;
+    }
+
+    // Only tables with constraints keep a bitset of the options given, the constraints were compiled for its size
+    if (settings->constraints != NULL)
+    {
+        if (settings->constraints->word_count != (structure_length + 63) / 64)
+        {
+            STATS_END(true);
+            return report_error(settings->error, DASH_ERROR_INVALID_TABLE, -1);
+        }
+        given = settings->constraints->word_count <= 4 ? small_given : malloc(settings->constraints->word_count * sizeof(uint64_t));
+        STATS_ADD(allocations, given != small_given);
+        if (given == NULL)
+        {
+            STATS_END(true);
+            return report_error(settings->error, DASH_ERROR_OUT_OF_MEMORY, -1);
+        }
+        memset(given, 0, settings->constraints->word_count * sizeof(uint64_t));
+    }
+
+    // Only tables with fallbacks keep track of the options given on the command line
+    if (fallback_count > 0 || settings->config != NULL)
+    {
+        fallback = structure_length <= 64 ? small_fallback : malloc(structure_length * sizeof(char*));
+        STATS_ADD(allocations, fallback != small_fallback);
+        if (fallback == NULL)
+        {
+            if (given != small_given)
+            {
+                free(given);
+            }
+            STATS_END(true);
+            return report_error(settings->error, DASH_ERROR_OUT_OF_MEMORY, -1);
+        }
+        memset(fallback, 0, structure_length * sizeof(char*));
+    }
+
+    STATS_PHASE(DASH_PHASE_MATCH);
+    cursor_init(&cursor, options, structure_length, settings->index, settings->flags, settings->error, *argc, argv);
+    while (next_match(&cursor, &match) && match.kind != MATCH_END)
+    {
+        if (match.kind == MATCH_POSITIONAL)
+        {
+            // Positional arguments are moved to the front as they are met, keeping their order
+            STATS_PHASE(DASH_PHASE_COMPACT);
+            argv[argument_non_option_count++] = match.value;
+            STATS_PHASE(DASH_PHASE_MATCH);
+            continue;
+        }
+        STATS_PHASE(DASH_PHASE_COPY);
+        if (fallback != NULL)
+        {
+            fallback[match.option_index] = given_on_command_line;
+        }
+        if (options[match.option_index].param_name == NULL)
+        {
+            store_flag(&options[match.option_index], match.unset);
+        }
+        else if (!store_value(options, match.option_index, match.value, match.unset, settings))
+        {
+            ok = report_argument(settings->error, match.argument_index, match.argument_index < *argc ? argv[match.argument_index] : NULL);
+            break;
+        }
+        if (given != NULL)
+        {
+            set_option_bit(given, match.option_index, value_given(&options[match.option_index]));
+        }
+        STATS_PHASE(DASH_PHASE_MATCH);
+    }
+    ok = ok && match.kind != MATCH_ERROR;
+
+    // Options missing from the command line fall back on the environment, then on the configuration file
+    if (ok && fallback != NULL)
+    {
+        STATS_PHASE(DASH_PHASE_COPY);
+        ok = collect_environment(options, structure_length, fallback) || report_error(settings->error, DASH_ERROR_OUT_OF_MEMORY, -1);
+        for (int i = 0; ok && i < structure_length; i++)
+        {
+            if (fallback[i] != NULL && fallback[i] != given_on_command_line)
+            {
+                ok = store_fallback(options, i, fallback[i], settings) || report_argument(settings->error, -1, fallback_entry(&options[i], fallback[i]));
+                if (ok && given != NULL)
+                {
+                    set_option_bit(given, i, value_given(&options[i]));
+                }
+            }
+        }
+        for (int i = 0; ok && settings->config != NULL && i < settings->config->entry_count; i++)
+        {
+            entry = &((const Config_Entry*) settings->config->entries)[i];
+            if ((option = find_config_option(options, structure_length, settings->index, entry)) == -1)
+            {
+                report_error(settings->error, DASH_ERROR_UNKNOWN_OPTION, -1);
+                ok = report_config(settings->error, entry, false);
+            }
+            else if (fallback[option] == NULL)
+            {
+                ok = store_fallback(options, option, entry->value, settings) || report_config(settings->error, entry, true);
+                if (ok && given != NULL)
+                {
+                    set_option_bit(given, option, value_given(&options[option]));
+                }
+            }
+        }
+    }
+    if (fallback != small_fallback)
+    {
+        free(fallback);
+    }
+
+    // Rules are checked once every value is known, wherever it comes from
+    if (given != NULL)
+    {
+        ok = ok && check_constraints(settings->constraints, given, settings->error);
+        if (given != small_given)
+        {
+            free(given);
+        }
+    }
+    if (!ok)
+    {
+        STATS_END(true);
+        return false;
+    }
+
+    STATS_PHASE(DASH_PHASE_COMPACT);
+    for (int i = argument_non_option_count; i < *argc; i++)
+    {
+        argv[i] = NULL;
+    }
+    *argc = argument_non_option_count;
+
+    STATS_END(true);
+    return true;
+}
+
+bool dash_arg_parser(int* argc, char* argv[], dash_Longopt* options)
+{
+    const dash_Settings settings = {0};
+
+    return parse_arguments(argc, argv, options, &settings);
+}
+
+bool dash_arg_parser_compiled(int* argc, char* argv[], const dash_Index* index)
+{
+    const dash_Settings settings = {.index = index};
+
+    return parse_arguments(argc, argv, index->options, &settings);
+}
+
+bool dash_arg_parser_ex(int* argc, char* argv[], dash_Longopt* options, const dash_Settings* settings)
+{
+    return parse_arguments(argc, argv, options, settings);
+}
+
+static int reset_group(const dash_Longopt* option)
+{
+    if (option->type == DASH_TYPE_COUNT)
+    {
+        return RESET_COUNT;
+    }
+    if (option->param_name == NULL)
+    {
+        return RESET_FLAG;
+    }
+    if (option->type == DASH_TYPE_LIST)
+    {
+        return RESET_LIST;
+    }
+    return option->type == DASH_TYPE_STRING ? RESET_STRING : RESET_NUMBER;
+}
+
+// Copy what every parse reads out of the table, once the hash table is filled
+static bool build_hot_index(dash_Index* index, const dash_Longopt* options, bool need_pointers)
+{
+    size_t table_size = index->long_mask + 1;
+    int structure_length = index->structure_length;
+    int value_count = 0;
+    int group_starts[RESET_GROUPS] = {0};
+    Hot_Index* hot;
+    const char* name;
+    size_t name_length;
+
+    for (int i = 0; need_pointers && i < structure_length; i++)
+    {
+        value_count += 1 + (options[i].unset_pointer != NULL);
+    }
+    hot = malloc(sizeof(Hot_Index) + table_size * sizeof(Hot_Slot) + value_count * sizeof(void*));
+    if (hot == NULL)
+    {
+        return false;
+    }
+    hot->long_slots = (Hot_Slot*) (hot + 1);
+    hot->values = need_pointers ? (void**) &hot->long_slots[table_size] : NULL;
+    hot->fallback_count = 0;
+    index->hot = hot;
+
+    for (size_t slot = 0; slot < table_size; slot++)
+    {
+        hot->long_slots[slot] = (Hot_Slot) {.option = index->long_options[slot]};
+        if (index->long_options[slot] != -1)
+        {
+            name = options[index->long_options[slot]].longopt_name;
+            name_length = strlen(name);
+            hot->long_slots[slot].prefix = name_prefix(name, name_length);
+            hot->long_slots[slot].hash = index->long_hashes[slot];
+            hot->long_slots[slot].length = (unsigned) name_length;
+        }
+    }
+
+    // Count the pointers of each group, then place them
+    memset(hot->group_ends, 0, sizeof(hot->group_ends));
+    for (int i = 0; i < structure_length; i++)
+    {
+        hot->fallback_count += options[i].env_name != NULL;
+        if (need_pointers)
+        {
+            hot->group_ends[reset_group(&options[i])]++;
+            hot->group_ends[RESET_UNSET] += options[i].unset_pointer != NULL;
+        }
+    }
+    for (int g = 1; g < RESET_GROUPS; g++)
+    {
+        group_starts[g] = hot->group_ends[g - 1];
+        hot->group_ends[g] += hot->group_ends[g - 1];
+    }
+    for (int i = 0; need_pointers && i < structure_length; i++)
+    {
+        hot->values[group_starts[reset_group(&options[i])]++] = options[i].user_pointer;
+        if (options[i].unset_pointer != NULL)
+        {
+            hot->values[group_starts[RESET_UNSET]++] = options[i].unset_pointer;
+        }
+    }
+    return true;
+}
+
+static bool compile_index(dash_Index* index, const dash_Longopt* options, bool need_pointers)
+{
+    int structure_length = 0;
+    int long_count = 0;
+    size_t table_size = 1;
+
+    size_t name_length;
+    unsigned hash;
+    size_t slot;
+
+    // The index never writes through its table, the pointer is only non-const for dash_arg_parser_compiled
+    index->options = (dash_Longopt*) options;
+    index->long_options = NULL;
+    index->long_hashes = NULL;
+    index->long_sorted = NULL;
+    index->long_count = 0;
+    index->prefix_nodes = NULL;
+    index->prefix_labels = NULL;
+    index->long_signatures = NULL;
+    index->hot = NULL;
+    index->table_hash = 0;
+    index->long_mask = 0;
+    for (int i = 0; i < 256; i++)
+    {
+        index->short_options[i] = -1;
+    }
+
+    while (options[structure_length].opt_name != '\0' || options[structure_length].longopt_name != NULL)
+    {
+        // Can't dereference a NULL pointer
+        if ((need_pointers && options[structure_length].user_pointer == NULL) || !valid_type(&options[structure_length]))
+        {
+            return false;
+        }
+
+        // Two options with the same short name
+        if (options[structure_length].opt_name != '\0')
+        {
+            if (index->short_options[(unsigned char) options[structure_length].opt_name] != -1)
+            {
+                return false;
+            }
+            index->short_options[(unsigned char) options[structure_length].opt_name] = structure_length;
+        }
+        if (options[structure_length].longopt_name != NULL)
+        {
+            // A '=' in a long name could never be matched
+            if (strchr(options[structure_length].longopt_name, '=') != NULL)
+            {
+                return false;
+            }
+            long_count++;
+        }
+        structure_length++;
+    }
+    index->structure_length = structure_length;
+    index->table_hash = hash_table(options);
+
+    // Keep the load factor under one half so probe sequences stay short
+    while (table_size < 2 * (size_t) long_count + 1)
+    {
+        table_size <<= 1;
+    }
+    index->long_options = malloc(table_size * sizeof(int));
+    index->long_hashes = malloc(table_size * sizeof(unsigned));
+    index->long_signatures = malloc((structure_length + 1) * sizeof(uint64_t));
+    if (index->long_options == NULL || index->long_hashes == NULL || index->long_signatures == NULL)
+    {
+        dash_free_index(index);
+        return false;
+    }
+    index->long_mask = table_size - 1;
+    for (size_t i = 0; i < table_size; i++)
+    {
+        index->long_options[i] = -1;
+    }
+
+    for (int i = 0; i < structure_length; i++)
+    {
+        index->long_signatures[i] = 0;
+        if (options[i].longopt_name == NULL)
+        {
+            continue;
+        }
+        name_length = strlen(options[i].longopt_name);
+        hash = hash_longopt(options[i].longopt_name, name_length);
+        index->long_signatures[i] = bigram_signature(options[i].longopt_name, name_length);
+        for (slot = hash & index->long_mask; index->long_options[slot] != -1; slot = (slot + 1) & index->long_mask)
+        {
+            // Two options with the same long name
+            if (index->long_hashes[slot] == hash && !strcmp(options[index->long_options[slot]].longopt_name, options[i].longopt_name))
+            {
+                dash_free_index(index);
+                return false;
+            }
+        }
+        index->long_options[slot] = i;
+        index->long_hashes[slot] = hash;
+    }
+
+    if (!build_prefix_tree(index, options, long_count) || !build_hot_index(index, options, need_pointers))
+    {
+        dash_free_index(index);
+        return false;
+    }
+    return true;
+}
+
+bool dash_compile_options(dash_Index* index, dash_Longopt* options)
+{
+    return compile_index(index, options, true);
+}
+
+void dash_free_index(dash_Index* index)
+{
+    free(index->long_options);
+    free(index->long_hashes);
+    free(index->long_sorted);
+    free(index->prefix_nodes);
+    free(index->prefix_labels);
+    free(index->long_signatures);
+    free(index->hot);
+    index->long_sorted = NULL;
+    index->long_count = 0;
+    index->prefix_nodes = NULL;
+    index->prefix_labels = NULL;
+    index->long_signatures = NULL;
+    index->hot = NULL;
+    index->long_options = NULL;
+    index->long_hashes = NULL;
+    index->long_mask = 0;
+}
+
+// Completion runs once per key press, so candidates come from the index when there is one, the sorted long names
+// give a contiguous range for any prefix
+static int find_completion_option(const dash_Longopt* options, const dash_Index* index, const char* name, size_t name_length)
+{
+    if (index != NULL)
+    {
+        return index->long_count > 0 ? lookup_longopt(index, name, name_length) : -1;
+    }
+    for (int i = 0; options[i].opt_name != '\0' || options[i].longopt_name != NULL; i++)
+    {
+        if (options[i].longopt_name != NULL && !strncmp(options[i].longopt_name, name, name_length) && options[i].longopt_name[name_length] == '\0')
+        {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static int find_completion_short(const dash_Longopt* options, const dash_Index* index, char name)
+{
+    if (index != NULL)
+    {
+        return index->short_options[(unsigned char) name];
+    }
+    for (int i = 0; options[i].opt_name != '\0' || options[i].longopt_name != NULL; i++)
+    {
+        if (options[i].opt_name == name)
+        {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// Whether the word before the cursor is an option still waiting for its parameter
+static bool expects_value(const dash_Longopt* options, const dash_Index* index, const char* word, size_t length)
+{
+    const dash_Longopt* option;
+    int found;
+
+    if (length < 2 || (word[0] != '-' && word[0] != '+'))
+    {
+        return false;
+    }
+    if (word[0] == '-' && word[1] == '-')
+    {
+        if (memchr(word, '=', length) != NULL)
+        {
+            return false;
+        }
+        found = find_completion_option(options, index, &word[2], length - 2);
+        return found != -1 && options[found].param_name != NULL;
+    }
+    for (size_t i = 1; i < length; i++)
+    {
+        if ((found = find_completion_short(options, index, word[i])) == -1)
+        {
+            return false;
+        }
+        option = &options[found];
+        // Like match_next_value, an option with a parameter at the end of a cluster takes the next argument
+        if (option->param_name != NULL)
+        {
+            return i == length - 1;
+        }
+    }
+    return false;
+}
+
+// One candidate per line, followed by a tab and its parameter and description when it has any
+static void append_candidate(Text_Buffer* text, char prefix, const dash_Longopt* option, bool long_name)
+{
+    const char* description = option->description;
+    const char* dollar;
+
+    append_text(text, &prefix, 1);
+    if (long_name)
+    {
+        append_text(text, "-", 1);
+        append_string(text, option->longopt_name);
+    }
+    else
+    {
+        append_text(text, &option->opt_name, 1);
+    }
+    if (option->param_name == NULL && description == NULL)
+    {
+        append_text(text, "\n", 1);
+        return;
+    }
+    append_text(text, "\t", 1);
+    if (option->param_name != NULL)
+    {
+        append_string(text, option->param_optional ? "[" : "");
+        append_string(text, option->param_name);
+        append_string(text, option->param_optional ? "]" : "");
+        append_string(text, description != NULL ? " " : "");
+    }
+    while (description != NULL && (dollar = strchr(description, '$')) != NULL)
+    {
+        append_text(text, description, dollar - description);
+        append_string(text, option->param_name != NULL ? option->param_name : "$");
+        description = dollar + 1;
+    }
+    if (description != NULL)
+    {
+        append_string(text, description);
+    }
+    append_text(text, "\n", 1);
+}
+
+static void append_long_candidates(Text_Buffer* text, const dash_Longopt* options, const dash_Index* index, const char* name, size_t name_length)
+{
+    int count;
+    int lo;
+
+    if (index != NULL)
+    {
+        count = lookup_prefix(index, name, name_length, &lo);
+        for (int i = lo; i < lo + count; i++)
+        {
+            append_candidate(text, '-', &options[index->long_sorted[i]], true);
+        }
+        return;
+    }
+    for (int i = 0; options[i].opt_name != '\0' || options[i].longopt_name != NULL; i++)
+    {
+        if (options[i].longopt_name != NULL && !strncmp(options[i].longopt_name, name, name_length))
+        {
+            append_candidate(text, '-', &options[i], true);
+        }
+    }
+}
+
+static void append_short_candidates(Text_Buffer* text, const dash_Longopt* options, const dash_Index* index, char prefix)
+{
+    // The short table of an index is already in character order
+    if (index != NULL)
+    {
+        for (int c = 1; c < 256; c++)
+        {
+            if (index->short_options[c] != -1 && (prefix == '-' || options[index->short_options[c]].allow_flag_unset))
+            {
+                append_candidate(text, prefix, &options[index->short_options[c]], false);
+            }
+        }
+        return;
+    }
+    for (int i = 0; options[i].opt_name != '\0' || options[i].longopt_name != NULL; i++)
+    {
+        if (options[i].opt_name != '\0' && (prefix == '-' || options[i].allow_flag_unset))
+        {
+            append_candidate(text, prefix, &options[i], false);
+        }
+    }
+}
+
+static void format_completions(Text_Buffer* text, const char* line, size_t position, const dash_Longopt* options, const dash_Index* index)
+{
+    const char* word = line;
+    const char* previous = NULL;
+    size_t previous_length = 0;
+    size_t length = 0;
+    bool ended = false;
+    int word_count = 0;
+    int found;
+
+    // Split the line up to the cursor on blanks, the last word is the one being completed, maybe empty
+    for (size_t i = 0; i < position && line[i] != '\0'; i++)
+    {
+        if (line[i] != ' ' && line[i] != '\t')
+        {
+            length++;
+            continue;
+        }
+        if (length > 0)
+        {
+            // The first word is the program
+            if (word_count > 0)
+            {
+                ended |= length == 2 && word[0] == '-' && word[1] == '-';
+                previous = word;
+                previous_length = length;
+            }
+            word_count++;
+        }
+        word = &line[i + 1];
+        length = 0;
+    }
+
+    if (word_count == 0 || ended || length == 0 || (word[0] != '-' && word[0] != '+'))
+    {
+        return;
+    }
+    if (word[0] == '+' && previous != NULL && expects_value(options, index, previous, previous_length))
+    {
+        return;
+    }
+
+    if (length == 1)
+    {
+        append_short_candidates(text, options, index, word[0]);
+        if (word[0] == '-')
+        {
+            append_long_candidates(text, options, index, "", 0);
+        }
+    }
+    else if (word[0] == '-' && word[1] == '-')
+    {
+        // A value after '=' is left to the shell
+        if (memchr(word, '=', length) == NULL)
+        {
+            append_long_candidates(text, options, index, &word[2], length - 2);
+        }
+    }
+    else if (length == 2 && (found = find_completion_short(options, index, word[1])) != -1 && (word[0] == '-' || options[found].allow_flag_unset))
+    {
+        append_candidate(text, word[0], &options[found], false);
+    }
+}
+
+size_t dash_format_completions(char* buffer, size_t size, const char* line, size_t position, const dash_Longopt* options, const dash_Settings* settings)
+{
+    Text_Buffer text = {.buffer = buffer, .size = size > 0 ? size - 1 : 0, .length = 0};
+
+    format_completions(&text, line, position, options, settings != NULL ? settings->index : NULL);
+    if (size > 0)
+    {
+        buffer[text.length < text.size ? text.length : text.size] = '\0';
+    }
+    return text.length;
+}
+
+void dash_print_completions(const char* line, size_t position, const dash_Longopt* options, const dash_Settings* settings, FILE* output_file)
+{
+    char stack_buffer[4096];
+    char* buffer = stack_buffer;
+    size_t length;
+
+    if (output_file == NULL)
+    {
+        output_file = stdout;
+    }
+
+    // Every candidate goes out in a single write
+    length = dash_format_completions(stack_buffer, sizeof(stack_buffer), line, position, options, settings);
+    if (length >= sizeof(stack_buffer))
+    {
+        buffer = malloc(length + 1);
+        if (buffer == NULL)
+        {
+            buffer = stack_buffer;
+            length = sizeof(stack_buffer) - 1;
+        }
+        else
+        {
+            dash_format_completions(buffer, length + 1, line, position, options, settings);
+        }
+    }
+    fwrite(buffer, 1, length, output_file);
+    fflush(output_file);
+    if (buffer != stack_buffer)
+    {
+        free(buffer);
+    }
+}
+
+// Text between single quotes, with the characters in escaped preceded by a backslash
+static void append_quoted(Text_Buffer* text, const char* str, size_t length, const char* escaped)
+{
+    for (size_t i = 0; i < length; i++)
+    {
+        if (str[i] == '\'')
+        {
+            append_text(text, "'\\''", 4);
+            continue;
+        }
+        if (escaped != NULL && strchr(escaped, str[i]) != NULL)
+        {
+            append_text(text, "\\", 1);
+        }
+        append_text(text, &str[i], 1);
+    }
+}
+
+// Name of the shell function, the program name without its directory and with only identifier characters
+static void append_function_name(Text_Buffer* text, const char* program)
+{
+    const char* slash = strrchr(program, '/');
+
+    append_text(text, "_", 1);
+    for (const char* c = slash != NULL ? slash + 1 : program; *c != '\0'; c++)
+    {
+        append_text(text, (*c >= 'a' && *c <= 'z') || (*c >= 'A' && *c <= 'Z') || (*c >= '0' && *c <= '9') ? c : "_", 1);
+    }
+}
+
+static void format_bash_script(Text_Buffer* text, const char* program, const dash_Longopt* options)
+{
+    const char* slash = strrchr(program, '/');
+    const char* name = slash != NULL ? slash + 1 : program;
+    char short_name[3] = {'-', '\0', '\0'};
+    bool first = true;
+
+    append_string(text, "# bash completion for ");
+    append_string(text, name);
+    append_string(text, "\n");
+    append_function_name(text, program);
+    append_string(text, "()\n{\n    local cur=${COMP_WORDS[COMP_CWORD]} prev=${COMP_WORDS[COMP_CWORD-1]} i\n");
+    append_string(text, "    for ((i = 1; i < COMP_CWORD; i++)); do\n        [[ ${COMP_WORDS[i]} == -- ]] && return\n    done\n");
+
+    // After an option with a parameter the shell completes files
+    for (int i = 0; options[i].opt_name != '\0' || options[i].longopt_name != NULL; i++)
+    {
+        if (options[i].param_name == NULL)
+        {
+            continue;
+        }
+        append_string(text, first ? "    case $prev in\n        " : "|");
+        first = false;
+        if (options[i].opt_name != '\0')
+        {
+            short_name[1] = options[i].opt_name;
+            append_string(text, "'");
+            append_quoted(text, short_name, 2, NULL);
+            append_string(text, options[i].longopt_name != NULL ? "'|" : "'");
+        }
+        if (options[i].longopt_name != NULL)
+        {
+            append_string(text, "'--");
+            append_quoted(text, options[i].longopt_name, strlen(options[i].longopt_name), NULL);
+            append_string(text, "'");
+        }
+    }
+    if (!first)
+    {
+        append_string(text, ") return ;;\n    esac\n");
+    }
+
+    append_string(text, "    case $cur in\n        -*) COMPREPLY=($(compgen -W '");
+    first = true;
+    for (int i = 0; options[i].opt_name != '\0' || options[i].longopt_name != NULL; i++)
+    {
+        if (options[i].opt_name != '\0')
+        {
+            short_name[1] = options[i].opt_name;
+            append_string(text, first ? "" : " ");
+            append_quoted(text, short_name, 2, NULL);
+            first = false;
+        }
+        if (options[i].longopt_name != NULL)
+        {
+            append_string(text, first ? "--" : " --");
+            append_quoted(text, options[i].longopt_name, strlen(options[i].longopt_name), NULL);
+            first = false;
+        }
+    }
+    append_string(text, "' -- \"$cur\")) ;;\n        +*) COMPREPLY=($(compgen -W '");
+    first = true;
+    short_name[0] = '+';
+    for (int i = 0; options[i].opt_name != '\0' || options[i].longopt_name != NULL; i++)
+    {
+        if (options[i].opt_name != '\0' && options[i].allow_flag_unset)
+        {
+            short_name[1] = options[i].opt_name;
+            append_string(text, first ? "" : " ");
+            append_quoted(text, short_name, 2, NULL);
+            first = false;
+        }
+    }
+    append_string(text, "' -- \"$cur\")) ;;\n    esac\n}\ncomplete -o default -F ");
+    append_function_name(text, program);
+    append_string(text, " ");
+    append_string(text, name);
+    append_string(text, "\n");
+}
+
+// Rest of an _arguments spec after the names, which leave their quote open: the description between brackets
+// then the parameter
+static void append_zsh_spec(Text_Buffer* text, const dash_Longopt* option)
+{
+    const char* description = option->description;
+    const char* dollar;
+
+    if (description != NULL)
+    {
+        append_string(text, "[");
+        while ((dollar = strchr(description, '$')) != NULL)
+        {
+            append_quoted(text, description, dollar - description, "[]\\");
+            append_quoted(text, option->param_name != NULL ? option->param_name : "$", option->param_name != NULL ? strlen(option->param_name) : 1, "[]\\");
+            description = dollar + 1;
+        }
+        append_quoted(text, description, strlen(description), "[]\\");
+        append_string(text, "]");
+    }
+    if (option->param_name != NULL)
+    {
+        append_string(text, option->param_optional ? "::" : ":");
+        append_quoted(text, option->param_name, strlen(option->param_name), ":\\");
+        append_string(text, ":_files");
+    }
+    append_string(text, "' \\\n");
+}
+
+static void format_zsh_script(Text_Buffer* text, const char* program, const dash_Longopt* options)
+{
+    const char* slash = strrchr(program, '/');
+    const char* name = slash != NULL ? slash + 1 : program;
+    const dash_Longopt* option;
+    bool repeatable;
+    bool both;
+
+    append_string(text, "#compdef ");
+    append_string(text, name);
+    append_string(text, "\n\n_arguments -s -S \\\n");
+    for (int i = 0; options[i].opt_name != '\0' || options[i].longopt_name != NULL; i++)
+    {
+        option = &options[i];
+        repeatable = option->type == DASH_TYPE_COUNT || option->type == DASH_TYPE_LIST;
+        both = option->opt_name != '\0' && option->longopt_name != NULL;
+
+        // Options given once exclude their other name, '+' after a short name and '=' after a long one take the
+        // parameter attached or in the next word, '-' and '=-' only attached
+        append_string(text, repeatable ? "    '*" : "    '");
+        if (both && !repeatable)
+        {
+            append_string(text, "(-");
+            append_quoted(text, &option->opt_name, 1, NULL);
+            append_string(text, " --");
+            append_quoted(text, option->longopt_name, strlen(option->longopt_name), NULL);
+            append_string(text, ")");
+        }
+        append_string(text, both ? "'{'-" : "-");
+        if (option->opt_name != '\0')
+        {
+            append_quoted(text, &option->opt_name, 1, NULL);
+            append_string(text, option->param_name == NULL ? "" : option->param_optional ? "-" : "+");
+        }
+        append_string(text, both ? "','" : "");
+        if (option->longopt_name != NULL)
+        {
+            append_string(text, option->opt_name == '\0' ? "-" : "--");
+            append_quoted(text, option->longopt_name, strlen(option->longopt_name), NULL);
+            append_string(text, option->param_name == NULL ? "" : option->param_optional ? "=-" : "=");
+        }
+        append_string(text, both ? "'}'" : "");
+        append_zsh_spec(text, option);
+
+        if (option->opt_name != '\0' && option->allow_flag_unset)
+        {
+            append_string(text, "    '+");
+            append_quoted(text, &option->opt_name, 1, NULL);
+            append_string(text, option->param_name == NULL ? "" : "+");
+            append_zsh_spec(text, option);
+        }
+    }
+    append_string(text, "    '*:file:_files'\n");
+}
+
+size_t dash_format_completion_script(char* buffer, size_t size, const char* program, dash_Shell shell, const dash_Longopt* options)
+{
+    Text_Buffer text = {.buffer = buffer, .size = size > 0 ? size - 1 : 0, .length = 0};
+
+    if (shell == DASH_SHELL_ZSH)
+    {
+        format_zsh_script(&text, program, options);
+    }
+    else
+    {
+        format_bash_script(&text, program, options);
+    }
+    if (size > 0)
+    {
+        buffer[text.length < text.size ? text.length : text.size] = '\0';
+    }
+    return text.length;
+}
+
+bool dash_print_completion_script(const char* program, dash_Shell shell, const dash_Longopt* options, FILE* output_file)
+{
+    size_t length = dash_format_completion_script(NULL, 0, program, shell, options);
+    char* buffer = malloc(length + 1);
+
+    if (buffer == NULL)
+    {
+        return false;
+    }
+    if (output_file == NULL)
+    {
+        output_file = stdout;
+    }
+    dash_format_completion_script(buffer, length + 1, program, shell, options);
+    fwrite(buffer, 1, length, output_file);
+    free(buffer);
+    return true;
+}
+
+void dash_free(dash_Longopt* options)
+{
+    int structure_length = 0;
+
+    STATS_BEGIN(DASH_PHASE_FREE);
+    while (options[structure_length].opt_name != '\0' || options[structure_length].longopt_name != NULL)
+    {
+        // Can't dereference a NULL pointer
+        if (options[structure_length].user_pointer == NULL)
+        {
+            continue;
+        }
+
+        // We put each pointer to NULL so we can know if they were allocated or not int the future.
+        if (options[structure_length].type == DASH_TYPE_LIST)
+        {
+            dash_List* list = (dash_List*) options[structure_length].user_pointer;
+            for (int i = 0; i < list->count; i++)
+            {
+                free(list->values[i]);
+            }
+            free(list->values);
+            *list = (dash_List) {0};
+        }
+        if(holds_string(&options[structure_length]))
+        {
+            char** p = (char**)options[structure_length].user_pointer;
+            free(*p);
+            *p = NULL;
+        }
+        structure_length++;
+    }
+    STATS_END(false);
+}
+
+void dash_free_ex(dash_Longopt* options, const dash_Settings* settings)
+{
+    if (!(settings->flags & DASH_ZERO_COPY) && settings->arena == NULL)
+    {
+        dash_free(options);
+        return;
+    }
+
+    STATS_BEGIN(DASH_PHASE_FREE);
+    // Values point into argv or into the arena, which is released at once
+    for (int i = 0; options[i].opt_name != '\0' || options[i].longopt_name != NULL; i++)
+    {
+        if (options[i].user_pointer != NULL && holds_string(&options[i]))
+        {
+            *((char**) options[i].user_pointer) = NULL;
+        }
+        // Only the array of values was allocated
+        if (options[i].user_pointer != NULL && options[i].type == DASH_TYPE_LIST)
+        {
+            free(((dash_List*) options[i].user_pointer)->values);
+            *((dash_List*) options[i].user_pointer) = (dash_List) {0};
+        }
+    }
+    if (settings->arena != NULL)
+    {
+        dash_arena_release(settings->arena);
+    }
+    STATS_END(false);
+}
+
+// The value of an option as it was before dash_reparse
+typedef struct {
+    union {
+        bool flag;
+        int count;
+        char* string;
+        dash_Number number;
+        dash_List list;
+    } value;
+    bool unset;
+    // First option of the table with the same variable, the only one that compares and frees it
+    int owner;
+    bool changed;
+} Saved_Value;
+
+// Options sharing a variable are found with a hash table of the variables, like dash_free they must touch it only once
+static bool find_owners(const dash_Longopt* options, int structure_length, Saved_Value* saved)
+{
+    int small_table[64];
+    int* table = small_table;
+    size_t table_size = 1;
+    size_t mask;
+    size_t slot;
+    int option;
+
+    while (table_size < 2 * (size_t) structure_length + 1)
+    {
+        table_size <<= 1;
+    }
+    if (table_size > sizeof(small_table) / sizeof(int))
+    {
+        table = malloc(table_size * sizeof(int));
+        if (table == NULL)
+        {
+            return false;
+        }
+    }
+    mask = table_size - 1;
+    for (size_t i = 0; i < table_size; i++)
+    {
+        table[i] = -1;
+    }
+    for (int i = 0; i < structure_length; i++)
+    {
+        slot = (size_t) (((uint64_t) (uintptr_t) options[i].user_pointer >> 3) * 0x9E3779B97F4A7C15u >> 32) & mask;
+        for (; (option = table[slot]) != -1 && options[option].user_pointer != options[i].user_pointer; slot = (slot + 1) & mask);
+        if (option == -1)
+        {
+            table[slot] = i;
+            option = i;
+        }
+        saved[i].owner = option;
+    }
+
+    if (table != small_table)
+    {
+        free(table);
+    }
+    return true;
+}
+
+static void save_value(const dash_Longopt* option, Saved_Value* saved)
+{
+    if (option->type == DASH_TYPE_COUNT)
+    {
+        saved->value.count = *((int*) option->user_pointer);
+    }
+    else if (option->param_name == NULL)
+    {
+        saved->value.flag = *((bool*) option->user_pointer);
+    }
+    else if (option->type == DASH_TYPE_LIST)
+    {
+        saved->value.list = *((dash_List*) option->user_pointer);
+    }
+    else if (option->type == DASH_TYPE_STRING)
+    {
+        saved->value.string = *((char**) option->user_pointer);
+    }
+    else
+    {
+        memcpy(&saved->value.number, option->user_pointer, sizeof(dash_Number));
+    }
+    saved->unset = option->unset_pointer != NULL && *option->unset_pointer;
+}
+
+static void restore_value(const dash_Longopt* option, const Saved_Value* saved)
+{
+    if (option->type == DASH_TYPE_COUNT)
+    {
+        *((int*) option->user_pointer) = saved->value.count;
+    }
+    else if (option->param_name == NULL)
+    {
+        *((bool*) option->user_pointer) = saved->value.flag;
+    }
+    else if (option->type == DASH_TYPE_LIST)
+    {
+        *((dash_List*) option->user_pointer) = saved->value.list;
+    }
+    else if (option->type == DASH_TYPE_STRING)
+    {
+        *((char**) option->user_pointer) = saved->value.string;
+    }
+    else
+    {
+        memcpy(option->user_pointer, &saved->value.number, sizeof(dash_Number));
+    }
+    if (option->unset_pointer != NULL)
+    {
+        *option->unset_pointer = saved->unset;
+    }
+}
+
+// Free what a value holds, the strings only when they were copied on the heap
+static void release_value(const dash_Longopt* option, Saved_Value* value, bool owned)
+{
+    if (option->type == DASH_TYPE_LIST)
+    {
+        for (int i = 0; owned && i < value->value.list.count; i++)
+        {
+            free(value->value.list.values[i]);
+        }
+        free(value->value.list.values);
+    }
+    else if (owned && holds_string(option))
+    {
+        free(value->value.string);
+    }
+}
+
+static bool same_string(const char* first, const char* second)
+{
+    return first == second || (first != NULL && second != NULL && !strcmp(first, second));
+}
+
+static bool same_value(const dash_Longopt* option, const Saved_Value* first, const Saved_Value* second)
+{
+    if (first->unset != second->unset)
+    {
+        return false;
+    }
+    if (option->type == DASH_TYPE_COUNT)
+    {
+        return first->value.count == second->value.count;
+    }
+    if (option->param_name == NULL)
+    {
+        return first->value.flag == second->value.flag;
+    }
+    if (option->type == DASH_TYPE_LIST)
+    {
+        if (first->value.list.count != second->value.list.count)
+        {
+            return false;
+        }
+        for (int i = 0; i < first->value.list.count; i++)
+        {
+            if (!same_string(first->value.list.values[i], second->value.list.values[i]))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+    if (option->type == DASH_TYPE_STRING)
+    {
+        return same_string(first->value.string, second->value.string);
+    }
+    return !memcmp(&first->value.number, &second->value.number, sizeof(dash_Number));
+}
+
+// Parse into a table holding the values of a previous parse with the same settings. The old values are kept for the
+// options that didn't change, so their strings keep their address, and only the values of the others are freed. On
+// failure the table is left as it was. The settings can't have an arena, a daemon reloading into it would never free it
+bool dash_reparse(int* argc, char* argv[], dash_Longopt* options, const dash_Settings* settings, uint64_t* changed)
+{
+    // Values pointing into argv are never freed one by one, and the new ones are always kept
+    bool owned = !(settings->flags & DASH_ZERO_COPY);
+    Saved_Value small_saved[32];
+    Saved_Value* saved;
+    Saved_Value current;
+    int structure_length = 0;
+
+    clear_error(settings->error);
+    // An arena only grows, and resetting it would also free the values that didn't change
+    if (settings->arena != NULL)
+    {
+        return report_error(settings->error, DASH_ERROR_INVALID_TABLE, -1);
+    }
+    while (options[structure_length].opt_name != '\0' || options[structure_length].longopt_name != NULL)
+    {
+        if (options[structure_length].user_pointer == NULL || !valid_type(&options[structure_length]))
+        {
+            return report_error(settings->error, DASH_ERROR_INVALID_TABLE, structure_length);
+        }
+        structure_length++;
+    }
+    saved = structure_length <= 32 ? small_saved : malloc(structure_length * sizeof(Saved_Value));
+    STATS_ADD(allocations, saved != small_saved);
+    if (saved == NULL || !find_owners(options, structure_length, saved))
+    {
+        if (saved != small_saved)
+        {
+            free(saved);
+        }
+        return report_error(settings->error, DASH_ERROR_OUT_OF_MEMORY, -1);
+    }
+    for (int i = 0; i < structure_length; i++)
+    {
+        save_value(&options[i], &saved[i]);
+    }
+    for (int i = 0; changed != NULL && i < (structure_length + 63) / 64; i++)
+    {
+        changed[i] = 0;
+    }
+
+    if (!parse_arguments(argc, argv, options, settings))
+    {
+        for (int i = 0; i < structure_length; i++)
+        {
+            if (saved[i].owner == i)
+            {
+                save_value(&options[i], &current);
+                release_value(&options[i], &current, owned);
+            }
+            restore_value(&options[i], &saved[i]);
+        }
+        if (saved != small_saved)
+        {
+            free(saved);
+        }
+        return false;
+    }
+
+    for (int i = 0; i < structure_length; i++)
+    {
+        save_value(&options[i], &current);
+        if (saved[i].owner != i)
+        {
+            // The variable was handled by its owner, which comes first, only the polarity is this option's own
+            if ((saved[saved[i].owner].changed || current.unset != saved[i].unset) && changed != NULL)
+            {
+                changed[i / 64] |= (uint64_t) 1 << (i % 64);
+            }
+        }
+        else if ((saved[i].changed = !same_value(&options[i], &saved[i], &current)))
+        {
+            release_value(&options[i], &saved[i], owned);
+            if (changed != NULL)
+            {
+                changed[i / 64] |= (uint64_t) 1 << (i % 64);
+            }
+        }
+        else if (owned)
+        {
+            release_value(&options[i], &current, owned);
+            restore_value(&options[i], &saved[i]);
+        }
+        else if (options[i].type == DASH_TYPE_LIST)
+        {
+            // Only the array of the old list was allocated
+            release_value(&options[i], &saved[i], owned);
+        }
+    }
+    if (saved != small_saved)
+    {
+        free(saved);
+    }
+    return true;
+}
+
+// "dash" in the byte order of the machine, an image written on another one doesn't match it
+#define SNAPSHOT_MAGIC 0x68736164u
+#define SNAPSHOT_VERSION 1u
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t table_hash;
+    uint32_t option_count;
+    uint32_t size;
+} Snapshot_Header;
+
+// The values of an image are grouped like the pointers of a hot index, so a compiled table binds each group with a
+// loop over both arrays. In each group they follow the order of the table, strings are offsets from the start of the
+// image, 0 for NULL, and lists are the offset of an array of string offsets followed by their count
+static const size_t snapshot_widths[RESET_GROUPS] = {1, sizeof(uint32_t), sizeof(uint32_t), sizeof(uint64_t), 2 * sizeof(uint32_t), 1};
+
+// Where each group starts, the last one ends where the arrays of the lists start
+static void snapshot_layout(const int counts[RESET_GROUPS], size_t starts[RESET_GROUPS + 1])
+{
+    starts[0] = sizeof(Snapshot_Header);
+    for (int g = 0; g < RESET_GROUPS; g++)
+    {
+        starts[g + 1] = starts[g] + counts[g] * snapshot_widths[g];
+    }
+}
+
+// Count the values of each group of a table, false when it can't be parsed
+static bool count_groups(const dash_Longopt* options, int counts[RESET_GROUPS], int* structure_length, dash_Error* error)
+{
+    memset(counts, 0, RESET_GROUPS * sizeof(int));
+    for (*structure_length = 0; options[*structure_length].opt_name != '\0' || options[*structure_length].longopt_name != NULL; (*structure_length)++)
+    {
+        if (options[*structure_length].user_pointer == NULL || !valid_type(&options[*structure_length]))
+        {
+            return report_error(error, DASH_ERROR_INVALID_TABLE, *structure_length);
+        }
+        counts[reset_group(&options[*structure_length])]++;
+        counts[RESET_UNSET] += options[*structure_length].unset_pointer != NULL;
+    }
+    return true;
+}
+
+// Write into the image only what fits, like snprintf
+static void snapshot_write(unsigned char* image, size_t size, size_t position, const void* data, size_t length)
+{
+    if (position + length <= size)
+    {
+        memcpy(image + position, data, length);
+    }
+}
+
+// Copy a string at the end of the image, the offset is counted even when it doesn't fit
+static uint32_t snapshot_string(unsigned char* image, size_t size, size_t* used, const char* string)
+{
+    size_t length;
+    size_t offset = *used;
+
+    if (string == NULL)
+    {
+        return 0;
+    }
+    length = strlen(string) + 1;
+    snapshot_write(image, size, offset, string, length);
+    *used += length;
+    return (uint32_t) offset;
+}
+
+// Write the values of a table into an image of the returned size. Unlike snprintf, the buffer is left untouched unless
+// the whole image fits. Returns 0 when the table is invalid or the image would be larger than 4GiB
+size_t dash_snapshot(void* buffer, size_t size, const dash_Longopt* options)
+{
+    unsigned char* image = buffer;
+    Snapshot_Header header = {SNAPSHOT_MAGIC, SNAPSHOT_VERSION, hash_table(options), 0, 0};
+    int counts[RESET_GROUPS];
+    int positions[RESET_GROUPS] = {0};
+    size_t starts[RESET_GROUPS + 1];
+    int structure_length;
+    Saved_Value saved;
+    size_t used;
+    size_t needed;
+    size_t items;
+    uint32_t field[2];
+    int group;
+
+    if (!count_groups(options, counts, &structure_length, NULL))
+    {
+        return 0;
+    }
+    snapshot_layout(counts, starts);
+    items = starts[RESET_GROUPS];
+    used = items;
+    for (int i = 0; i < structure_length; i++)
+    {
+        if (options[i].type == DASH_TYPE_LIST)
+        {
+            used += ((dash_List*) options[i].user_pointer)->count * sizeof(uint32_t);
+        }
+    }
+    if (image == NULL)
+    {
+        size = 0;
+    }
+    // Strings are only measured as they are written, so a first pass without a buffer tells whether the image fits
+    else if ((needed = dash_snapshot(NULL, 0, options)) == 0 || needed > size)
+    {
+        return needed;
+    }
+
+    for (int i = 0; i < structure_length; i++)
+    {
+        save_value(&options[i], &saved);
+        group = reset_group(&options[i]);
+        if (group == RESET_LIST)
+        {
+            field[0] = saved.value.list.count > 0 ? (uint32_t) items : 0;
+            field[1] = (uint32_t) saved.value.list.count;
+            for (int k = 0; k < saved.value.list.count; k++, items += sizeof(uint32_t))
+            {
+                uint32_t offset = snapshot_string(image, size, &used, saved.value.list.values[k]);
+                snapshot_write(image, size, items, &offset, sizeof(uint32_t));
+            }
+        }
+        else if (group == RESET_STRING)
+        {
+            field[0] = snapshot_string(image, size, &used, saved.value.string);
+        }
+        else if (group == RESET_COUNT)
+        {
+            field[0] = (uint32_t) saved.value.count;
+        }
+        else if (group == RESET_FLAG)
+        {
+            ((unsigned char*) field)[0] = saved.value.flag;
+        }
+        else
+        {
+            memcpy(field, &saved.value.number, sizeof(uint64_t));
+        }
+        snapshot_write(image, size, starts[group] + positions[group]++ * snapshot_widths[group], field, snapshot_widths[group]);
+        if (options[i].unset_pointer != NULL)
+        {
+            snapshot_write(image, size, starts[RESET_UNSET] + positions[RESET_UNSET]++, &saved.unset, 1);
+        }
+    }
+
+    // A last '\0' ends every string of the image, even a damaged one
+    used++;
+    if (used > UINT32_MAX)
+    {
+        return 0;
+    }
+    header.option_count = (uint32_t) structure_length;
+    header.size = (uint32_t) used;
+    if (used <= size)
+    {
+        memcpy(image, &header, sizeof(header));
+        image[used - 1] = '\0';
+    }
+    return used;
+}
+
+static char* snapshot_pointer(unsigned char* image, size_t size, uint32_t offset)
+{
+    return offset != 0 && offset < size ? (char*) image + offset : NULL;
+}
+
+// Bind a value of any group but the lists
+static void bind_value(unsigned char* image, size_t size, int group, const unsigned char* field, void* pointer)
+{
+    uint32_t word;
+
+    switch (group)
+    {
+        case RESET_FLAG:
+        case RESET_UNSET:
+            *((bool*) pointer) = *field != 0;
+            break;
+        case RESET_COUNT:
+            memcpy(&word, field, sizeof(uint32_t));
+            *((int*) pointer) = (int) word;
+            break;
+        case RESET_STRING:
+            memcpy(&word, field, sizeof(uint32_t));
+            *((char**) pointer) = snapshot_pointer(image, size, word);
+            break;
+        default:
+            memcpy(pointer, field, sizeof(dash_Number));
+            break;
+    }
+}
+
+// The only allocation of a restore, lists are released like the ones of a parse
+static bool bind_list(unsigned char* image, size_t size, const unsigned char* field, dash_List* list)
+{
+    uint32_t items[2];
+    uint32_t offset;
+
+    memcpy(items, field, sizeof(items));
+    *list = (dash_List) {NULL, (int) items[1], (int) items[1]};
+    if (items[1] == 0)
+    {
+        return true;
+    }
+    list->values = malloc(items[1] * sizeof(char*));
+    STATS_ADD(allocations, 1);
+    if (list->values == NULL)
+    {
+        list->count = 0;
+        list->capacity = 0;
+        return false;
+    }
+    for (uint32_t k = 0; k < items[1]; k++)
+    {
+        memcpy(&offset, image + items[0] + k * sizeof(uint32_t), sizeof(uint32_t));
+        list->values[k] = snapshot_pointer(image, size, offset);
+    }
+    return true;
+}
+
+// Bind the values of a table to an image written by dash_snapshot for the same table. Strings point into the image,
+// which has to outlive them, and the values are released with dash_free_ex and DASH_ZERO_COPY, even after a failure.
+// With a compiled table in the settings, the table isn't checked again and each group is bound by a loop of its own
+bool dash_restore(void* buffer, size_t size, dash_Longopt* options, const dash_Settings* settings)
+{
+    unsigned char* image = buffer;
+    dash_Error* error = settings != NULL ? settings->error : NULL;
+    const dash_Index* index = settings != NULL ? settings->index : NULL;
+    const Hot_Index* hot = index != NULL ? index->hot : NULL;
+    Snapshot_Header header;
+    int counts[RESET_GROUPS];
+    int positions[RESET_GROUPS] = {0};
+    size_t starts[RESET_GROUPS + 1];
+    int structure_length;
+    uint32_t items[2];
+    dash_List* list;
+    int group;
+
+    clear_error(error);
+    if (hot != NULL && hot->values != NULL)
+    {
+        structure_length = index->structure_length;
+        for (int g = 0; g < RESET_GROUPS; g++)
+        {
+            counts[g] = hot->group_ends[g] - (g > 0 ? hot->group_ends[g - 1] : 0);
+        }
+    }
+    else if (!count_groups(options, counts, &structure_length, error))
+    {
+        return false;
+    }
+    snapshot_layout(counts, starts);
+
+    if (size < sizeof(header))
+    {
+        return report_error(error, DASH_ERROR_INVALID_SNAPSHOT, -1);
+    }
+    memcpy(&header, image, sizeof(header));
+    if (header.magic != SNAPSHOT_MAGIC || header.version != SNAPSHOT_VERSION || header.size != size || image[size - 1] != '\0')
+    {
+        return report_error(error, DASH_ERROR_INVALID_SNAPSHOT, -1);
+    }
+    if (header.option_count != (uint32_t) structure_length || header.table_hash != (index != NULL ? index->table_hash : hash_table(options)))
+    {
+        return report_error(error, DASH_ERROR_SNAPSHOT_MISMATCH, -1);
+    }
+
+    // Offsets are only checked to stay in the image, the values were checked by the parse that made it. The arrays of
+    // the lists are checked before anything is bound, so only running out of memory fails halfway
+    if (size < starts[RESET_GROUPS])
+    {
+        return report_error(error, DASH_ERROR_INVALID_SNAPSHOT, -1);
+    }
+    for (int k = 0; k < counts[RESET_LIST]; k++)
+    {
+        memcpy(items, image + starts[RESET_LIST] + k * snapshot_widths[RESET_LIST], sizeof(items));
+        if (items[1] > INT32_MAX || items[0] >= size || items[1] > (size - items[0]) / sizeof(uint32_t))
+        {
+            return report_error(error, DASH_ERROR_INVALID_SNAPSHOT, -1);
+        }
+    }
+
+    if (hot != NULL && hot->values != NULL)
+    {
+        for (int g = 0; g < RESET_GROUPS; g++)
+        {
+            for (int i = g > 0 ? hot->group_ends[g - 1] : 0, k = 0; i < hot->group_ends[g]; i++, k++)
+            {
+                if (g == RESET_LIST)
+                {
+                    if (!bind_list(image, size, image + starts[g] + k * snapshot_widths[g], hot->values[i]))
+                    {
+                        return report_error(error, DASH_ERROR_OUT_OF_MEMORY, -1);
+                    }
+                    continue;
+                }
+                bind_value(image, size, g, image + starts[g] + k * snapshot_widths[g], hot->values[i]);
+            }
+        }
+        return true;
+    }
+
+    for (int i = 0; i < structure_length; i++)
+    {
+        group = reset_group(&options[i]);
+        if (group == RESET_LIST)
+        {
+            list = options[i].user_pointer;
+            if (!bind_list(image, size, image + starts[group] + positions[group]++ * snapshot_widths[group], list))
+            {
+                return report_error(error, DASH_ERROR_OUT_OF_MEMORY, i);
+            }
+        }
+        else
+        {
+            bind_value(image, size, group, image + starts[group] + positions[group]++ * snapshot_widths[group], options[i].user_pointer);
+        }
+        if (options[i].unset_pointer != NULL)
+        {
+            bind_value(image, size, RESET_UNSET, image + starts[RESET_UNSET] + positions[RESET_UNSET]++, options[i].unset_pointer);
+        }
+    }
+    return true;
+}
+
+// Command names go in the same kind of hash table as long option names, nothing is done for the tables of the commands
+bool dash_commands_init(dash_Commands* commands, dash_Longopt* options, const dash_Command* command_table)
+{
+    size_t table_size = 1;
+    unsigned hash;
+    size_t slot;
+
+    commands->options = options;
+    commands->commands = command_table;
+    commands->command_count = 0;
+    while (command_table[commands->command_count].name != NULL)
+    {
+        commands->command_count++;
+    }
+    while (table_size < 2 * (size_t) commands->command_count + 1)
+    {
+        table_size <<= 1;
+    }
+    commands->mask = table_size - 1;
+    commands->slots = malloc(table_size * sizeof(int));
+    commands->hashes = malloc(table_size * sizeof(unsigned));
+    commands->indexes = malloc((commands->command_count + 1) * sizeof(dash_Index));
+    commands->indexed = calloc(commands->command_count + 1, sizeof(bool));
+    if (commands->slots == NULL || commands->hashes == NULL || commands->indexes == NULL || commands->indexed == NULL)
+    {
+        dash_commands_free(commands);
+        return false;
+    }
+    for (size_t i = 0; i < table_size; i++)
+    {
+        commands->slots[i] = -1;
+    }
+
+    for (int i = 0; i < commands->command_count; i++)
+    {
+        hash = hash_longopt(command_table[i].name, strlen(command_table[i].name));
+        for (slot = hash & commands->mask; commands->slots[slot] != -1; slot = (slot + 1) & commands->mask)
+        {
+            // Two commands with the same name
+            if (commands->hashes[slot] == hash && !strcmp(command_table[commands->slots[slot]].name, command_table[i].name))
+            {
+                dash_commands_free(commands);
+                return false;
+            }
+        }
+        commands->slots[slot] = i;
+        commands->hashes[slot] = hash;
+    }
+    return true;
+}
+
+void dash_commands_free(dash_Commands* commands)
+{
+    for (int i = 0; commands->indexed != NULL && i < commands->command_count; i++)
+    {
+        if (commands->indexed[i])
+        {
+            dash_free_index(&commands->indexes[i]);
+        }
+    }
+    free(commands->slots);
+    free(commands->hashes);
+    free(commands->indexes);
+    free(commands->indexed);
+    commands->slots = NULL;
+    commands->hashes = NULL;
+    commands->indexes = NULL;
+    commands->indexed = NULL;
+    commands->command_count = 0;
+}
+
+static int find_command(const dash_Commands* commands, const char* name)
+{
+    unsigned hash = hash_longopt(name, strlen(name));
+
+    for (size_t slot = hash & commands->mask; commands->slots[slot] != -1; slot = (slot + 1) & commands->mask)
+    {
+        if (commands->hashes[slot] == hash && !strcmp(commands->commands[commands->slots[slot]].name, name))
+        {
+            return commands->slots[slot];
+        }
+    }
+    return -1;
+}
+
+// Global options go before the command and the options of the command after it, argv ends up as
+// the program, the command and the positional arguments of the command
+bool dash_parse_command(dash_Commands* commands, int* argc, char* argv[], const dash_Command** command, const dash_Settings* settings)
+{
+    static dash_Longopt no_options[] = {{0}};
+    dash_Longopt* options = commands->options != NULL ? commands->options : no_options;
+    dash_Settings command_settings = *settings;
+    int structure_length = 0;
+    int command_argc;
+    int prefix_argc;
+    int found;
+    Cursor cursor;
+    Match match;
+
+    *command = NULL;
+    clear_error(settings->error);
+    while (options[structure_length].opt_name != '\0' || options[structure_length].longopt_name != NULL)
+    {
+        structure_length++;
+    }
+
+    // The command is the first positional argument, which takes reading the options before it without storing them
+    cursor_init(&cursor, options, structure_length, settings->index, settings->flags, settings->error, *argc, argv);
+    while (next_match(&cursor, &match) && match.kind == MATCH_OPTION);
+    if (match.kind == MATCH_ERROR)
+    {
+        return false;
+    }
+    prefix_argc = match.kind == MATCH_POSITIONAL ? match.argument_index : *argc;
+    if (!parse_arguments(&prefix_argc, argv, options, settings))
+    {
+        return false;
+    }
+    if (match.kind != MATCH_POSITIONAL)
+    {
+        *argc = prefix_argc;
+        return true;
+    }
+
+    if ((found = find_command(commands, argv[match.argument_index])) == -1)
+    {
+        report_error(settings->error, DASH_ERROR_UNKNOWN_COMMAND, -1);
+        return report_argument(settings->error, match.argument_index, argv[match.argument_index]);
+    }
+
+    // Only the table of the selected command is reset and parsed, and only indexed when the global options are
+    if (settings->index != NULL && !commands->indexed[found])
+    {
+        if (!dash_compile_options(&commands->indexes[found], commands->commands[found].options))
+        {
+            return report_error(settings->error, DASH_ERROR_INVALID_TABLE, -1);
+        }
+        commands->indexed[found] = true;
+    }
+    command_settings.index = commands->indexed[found] ? &commands->indexes[found] : NULL;
+    // A configuration file and constraints are about global options, the bits of rules would name other options here
+    command_settings.config = NULL;
+    command_settings.constraints = NULL;
+
+    // The command name stands for argv[0] of its own command line
+    command_argc = *argc - match.argument_index;
+    if (!parse_arguments(&command_argc, &argv[match.argument_index], commands->commands[found].options, &command_settings))
+    {
+        // Indices of the error are relative to the command name
+        if (settings->error != NULL && settings->error->argument_index != -1)
+        {
+            settings->error->argument_index += match.argument_index;
+        }
+        return false;
+    }
+    memmove(&argv[1], &argv[match.argument_index], command_argc * sizeof(char*));
+    for (int i = command_argc + 1; i < *argc; i++)
+    {
+        argv[i] = NULL;
+    }
+    *argc = command_argc + 1;
+    *command = &commands->commands[found];
+    return true;
+}
+
+// The global options, then the commands with their descriptions
+void dash_print_commands(const char* argv0, const char* header, const char* footer, const dash_Commands* commands, FILE* output_file)
+{
+    static const dash_Longopt no_options[] = {{0}};
+    const char* required_arguments[] = {"<command>", "[arguments]", NULL};
+    int width = 0;
+
+    if (output_file == NULL)
+    {
+        output_file = stderr;
+    }
+    for (int i = 0; i < commands->command_count; i++)
+    {
+        if ((int) strlen(commands->commands[i].name) > width)
+        {
+            width = (int) strlen(commands->commands[i].name);
+        }
+    }
+    dash_print_usage(argv0, header, "Commands:", required_arguments, commands->options != NULL ? commands->options : no_options, output_file);
+    for (int i = 0; i < commands->command_count; i++)
+    {
+        fprintf(output_file, "  %-*s  %s\n", width, commands->commands[i].name, commands->commands[i].description != NULL ? commands->commands[i].description : "");
+    }
+    fprintf(output_file, "%s\n", footer);
+}
+
+// The usage of a command is only formatted when it is asked for, as "argv0 command [options]"
+void dash_print_command_usage(const char* argv0, const char* header, const char* footer, const char* required_arguments[], const dash_Command* command, FILE* output_file)
+{
+    size_t length = strlen(argv0) + strlen(command->name) + 2;
+    char stack_name[256];
+    char* name = length <= sizeof(stack_name) ? stack_name : malloc(length);
+
+    if (name == NULL)
+    {
+        dash_print_usage(command->name, header, footer, required_arguments, command->options, output_file);
+        return;
+    }
+    memcpy(name, argv0, strlen(argv0));
+    name[strlen(argv0)] = ' ';
+    memcpy(&name[strlen(argv0) + 1], command->name, strlen(command->name) + 1);
+    dash_print_usage(name, header, footer, required_arguments, command->options, output_file);
+    if (name != stack_name)
+    {
+        free(name);
+    }
+}
+
+bool dash_parser_init(dash_Parser* parser, const dash_Longopt* options)
+{
+    parser->options = options;
+    parser->flags = 0;
+    parser->config = NULL;
+    parser->constraints = NULL;
+    return compile_index(&parser->index, options, false);
+}
+
+void dash_parser_free(dash_Parser* parser)
+{
+    dash_free_index(&parser->index);
+}
+
+bool dash_result_init(dash_Result* result, const dash_Parser* parser)
+{
+    result->option_count = parser->index.structure_length;
+    result->arguments = NULL;
+    result->argument_count = 0;
+    result->argument_capacity = 0;
+    clear_error(&result->error);
+
+    // One extra slot so an empty table still gets a valid allocation
+    result->values = calloc(result->option_count + 1, sizeof(dash_Value));
+    return result->values != NULL;
+}
+
+// Store one value of an option in a result, from the command line or from a fallback
+static dash_Error_Code set_result_value(const dash_Longopt* option, dash_Value* value, char* text, bool unset)
+{
+    if (holds_string(option) && value->present)
+    {
+        return DASH_ERROR_ALREADY_SET;
+    }
+    value->present = true;
+    value->unset = unset;
+    value->value = text;
+    switch (option->type)
+    {
+        case DASH_TYPE_COUNT:
+            value->number.int64 = unset ? 0 : value->number.int64 + 1;
+            return DASH_ERROR_NONE;
+        case DASH_TYPE_LIST:
+            return list_append(&value->list, text) ? DASH_ERROR_NONE : DASH_ERROR_OUT_OF_MEMORY;
+        case DASH_TYPE_STRING:
+            return DASH_ERROR_NONE;
+        default:
+            return convert_value(option, text, &value->number);
+    }
+}
+
+// Same as store_fallback for a result, a boolean from the environment or a configuration file is a set or unset flag
+static dash_Error_Code set_result_fallback(const dash_Longopt* option, dash_Value* value, char* text)
+{
+    dash_Error_Code code;
+    dash_Number number;
+
+    if (option->param_name != NULL)
+    {
+        return set_result_value(option, value, text, false);
+    }
+    if ((code = convert_flag(option, text, &number)) == DASH_ERROR_NONE)
+    {
+        value->present = true;
+        value->value = text;
+        value->unset = option->type != DASH_TYPE_COUNT && number.int64 == 0;
+        value->number = number;
+    }
+    return code;
+}
+
+static bool set_result_fallbacks(const dash_Parser* parser, dash_Result* result, char** fallback)
+{
+    const dash_Longopt* options = parser->options;
+    const Config_Entry* entry;
+    dash_Error_Code code;
+    int option;
+
+    if (!collect_environment(options, result->option_count, fallback))
+    {
+        return report_error(&result->error, DASH_ERROR_OUT_OF_MEMORY, -1);
+    }
+    for (int i = 0; i < result->option_count; i++)
+    {
+        if (fallback[i] == NULL || fallback[i] == given_on_command_line)
+        {
+            continue;
+        }
+        if ((code = set_result_fallback(&options[i], &result->values[i], fallback[i])) != DASH_ERROR_NONE)
+        {
+            report_error(&result->error, code, i);
+            return report_argument(&result->error, -1, fallback_entry(&options[i], fallback[i]));
+        }
+    }
+
+    for (int i = 0; parser->config != NULL && i < parser->config->entry_count; i++)
+    {
+        entry = &((const Config_Entry*) parser->config->entries)[i];
+        if ((option = lookup_longopt(&parser->index, entry->key, entry->key_length)) == -1)
+        {
+            report_error(&result->error, DASH_ERROR_UNKNOWN_OPTION, -1);
+            return report_config(&result->error, entry, false);
+        }
+        if (fallback[option] == NULL && (code = set_result_fallback(&options[option], &result->values[option], entry->value)) != DASH_ERROR_NONE)
+        {
+            report_error(&result->error, code, option);
+            return report_config(&result->error, entry, true);
+        }
+    }
+    return true;
+}
+
+static bool parse_result(const dash_Parser* parser, int argc, char* const argv[], dash_Result* result)
+{
+    const dash_Longopt* options = parser->options;
+    dash_Error_Code code;
+    char* small_fallback[64];
+    char** fallback = NULL;
+    char** arguments;
+    Cursor cursor;
+    Match match;
+    bool ok;
+
+    clear_error(&result->error);
+    result->argument_count = 0;
+    for (int i = 0; i < result->option_count; i++)
+    {
+        // Lists keep their storage from one parse to the next
+        result->values[i] = (dash_Value) {.list = {result->values[i].list.values, 0, result->values[i].list.capacity}};
+    }
+
+    // Every positional argument fits in one allocation made up front
+    if (result->argument_capacity < argc)
+    {
+        arguments = realloc(result->arguments, argc * sizeof(char*));
+        STATS_ADD(allocations, 1);
+        if (arguments == NULL)
+        {
+            return report_error(&result->error, DASH_ERROR_OUT_OF_MEMORY, -1);
+        }
+        result->arguments = arguments;
+        result->argument_capacity = argc;
+    }
+
+    // The cursor only reads argv, the cast lets it share the legacy parser's signature
+    STATS_PHASE(DASH_PHASE_MATCH);
+    cursor_init(&cursor, options, result->option_count, &parser->index, parser->flags, &result->error, argc, (char**) argv);
+    while (next_match(&cursor, &match) && match.kind != MATCH_END)
+    {
+        if (match.kind == MATCH_POSITIONAL)
+        {
+            result->arguments[result->argument_count++] = match.value;
+            continue;
+        }
+        STATS_PHASE(DASH_PHASE_COPY);
+        if ((code = set_result_value(&options[match.option_index], &result->values[match.option_index], match.value, match.unset)) != DASH_ERROR_NONE)
+        {
+            report_error(&result->error, code, match.option_index);
+            return report_argument(&result->error, match.argument_index, match.argument_index < argc ? argv[match.argument_index] : NULL);
+        }
+        STATS_PHASE(DASH_PHASE_MATCH);
+    }
+    if (match.kind == MATCH_ERROR)
+    {
+        return false;
+    }
+
+    // Options missing from the command line fall back on the environment, then on the configuration file
+    STATS_PHASE(DASH_PHASE_COPY);
+    for (int i = 0; i < result->option_count && fallback == NULL; i++)
+    {
+        if (options[i].env_name != NULL || parser->config != NULL)
+        {
+            fallback = result->option_count <= 64 ? small_fallback : malloc(result->option_count * sizeof(char*));
+            STATS_ADD(allocations, fallback != small_fallback);
+            if (fallback == NULL)
+            {
+                return report_error(&result->error, DASH_ERROR_OUT_OF_MEMORY, -1);
+            }
+        }
+    }
+    if (fallback == NULL)
+    {
+        return true;
+    }
+    for (int i = 0; i < result->option_count; i++)
+    {
+        fallback[i] = result->values[i].present ? given_on_command_line : NULL;
+    }
+    ok = set_result_fallbacks(parser, result, fallback);
+    if (fallback != small_fallback)
+    {
+        free(fallback);
+    }
+    return ok;
+}
 
-    int structure_length = 0;
+// Same as value_given for a result
+static bool result_given(const dash_Longopt* option, const dash_Value* value)
+{
+    if (option->param_name != NULL)
+    {
+        return value->present;
+    }
+    return option->type == DASH_TYPE_COUNT ? value->number.int64 != 0 : value->present && !value->unset;
+}
+
+// A result records which options are present, so only the options named by the rules are looked at
+static bool check_result_constraints(const dash_Parser* parser, dash_Result* result)
+{
+    const dash_Constraints* constraints = parser->constraints;
+    int words = constraints->word_count;
+    uint64_t small_given[4];
+    uint64_t* given;
+    uint64_t bits;
+    bool ok;
+
+    if (words != (result->option_count + 63) / 64)
+    {
+        return report_error(&result->error, DASH_ERROR_INVALID_TABLE, -1);
+    }
+    given = words <= 4 ? small_given : malloc(words * sizeof(uint64_t));
+    STATS_ADD(allocations, given != small_given);
+    if (given == NULL)
+    {
+        return report_error(&result->error, DASH_ERROR_OUT_OF_MEMORY, -1);
+    }
+    memset(given, 0, words * sizeof(uint64_t));
+    for (size_t k = 0; k < 2 * (size_t) constraints->rule_count * words; k++)
+    {
+        for (bits = constraints->masks[k]; bits != 0; bits &= bits - 1)
+        {
+            int option = (int) (k % words) * 64 + first_bit(bits);
+            set_option_bit(given, option, result_given(&parser->options[option], &result->values[option]));
+        }
+    }
+    ok = check_constraints(constraints, given, &result->error);
+    if (given != small_given)
+    {
+        free(given);
+    }
+    return ok;
+}
+
+// Results don't need compacting, a parse only goes through the init, match and copy phases
+bool dash_parse(const dash_Parser* parser, int argc, char* const argv[], dash_Result* result)
+{
+    bool ok;
+
+    STATS_BEGIN(DASH_PHASE_INIT);
+    ok = parse_result(parser, argc, argv, result);
+    if (ok && parser->constraints != NULL)
+    {
+        ok = check_result_constraints(parser, result);
+    }
+    STATS_END(true);
+    return ok;
+}
+
+// Only the table is walked, values are neither reset nor stored
+void dash_begin(dash_Iterator* iterator, int argc, char* const argv[], const dash_Longopt* options, const dash_Settings* settings)
+{
+    iterator->options = options;
+    iterator->index = settings != NULL ? settings->index : NULL;
+    iterator->flags = settings != NULL ? settings->flags : 0;
+    iterator->structure_length = 0;
+    if (iterator->index != NULL)
+    {
+        iterator->structure_length = iterator->index->structure_length;
+    }
+    else
+    {
+        while (options[iterator->structure_length].opt_name != '\0' || options[iterator->structure_length].longopt_name != NULL)
+        {
+            iterator->structure_length++;
+        }
+    }
+    iterator->argc = argc;
+    iterator->argv = argv;
+    iterator->argument = 1;
+    iterator->position = 0;
+    iterator->unset = false;
+    iterator->ended = false;
+    clear_error(&iterator->error);
+}
+
+// The reading position is kept in the iterator between calls, the cursor only lives for one match
+bool dash_next(dash_Iterator* iterator, dash_Item* item)
+{
+    Cursor cursor;
+    Match match;
+
+    STATS_BEGIN(DASH_PHASE_MATCH);
+    // The cursor only reads argv, like for dash_parse
+    cursor_init(&cursor, iterator->options, iterator->structure_length, iterator->index, iterator->flags, &iterator->error, iterator->argc, (char**) iterator->argv);
+    cursor.argument = iterator->argument;
+    cursor.position = iterator->position;
+    cursor.unset = iterator->unset;
+    cursor.ended = iterator->ended;
+    next_match(&cursor, &match);
+    iterator->argument = cursor.argument;
+    iterator->position = cursor.position;
+    iterator->unset = cursor.unset;
+    iterator->ended = cursor.ended;
+    STATS_END(false);
+
+    if (match.kind == MATCH_END || match.kind == MATCH_ERROR)
+    {
+        return false;
+    }
+    item->option_index = match.kind == MATCH_POSITIONAL ? -1 : match.option_index;
+    item->argument_index = match.argument_index;
+    item->value = match.value;
+    item->unset = match.kind == MATCH_OPTION && match.unset;
+    return true;
+}
+
+void dash_result_free(dash_Result* result)
+{
+    for (int i = 0; result->values != NULL && i < result->option_count; i++)
+    {
+        free(result->values[i].list.values);
+    }
+    free(result->values);
+    free(result->arguments);
+    result->values = NULL;
+    result->arguments = NULL;
+    result->option_count = 0;
+    result->argument_count = 0;
+    result->argument_capacity = 0;
+}
+
+void dash_arena_init(dash_Arena* arena, void* buffer, size_t size)
+{
+    arena->buffer = buffer;
+    arena->size = buffer != NULL ? size : 0;
+    arena->used = 0;
+    arena->blocks = NULL;
+    arena->growable = buffer == NULL;
+}
+
+void dash_arena_release(dash_Arena* arena)
+{
+    void** block = arena->blocks;
+    void** next;
+
+    while (block != NULL)
+    {
+        next = *block;
+        free(block);
+        block = next;
+    }
+    arena->blocks = NULL;
+    if (arena->growable)
+    {
+        arena->buffer = NULL;
+        arena->size = 0;
+    }
+    arena->used = 0;
+}
+
+const char* dash_error_message(const dash_Error* error)
+{
+    switch (error->code)
+    {
+        case DASH_ERROR_NONE:
+            return "No error";
+        case DASH_ERROR_INVALID_TABLE:
+            return "Option has no user_pointer";
+        case DASH_ERROR_UNKNOWN_OPTION:
+            return "Unknown option";
+        case DASH_ERROR_UNSET_NOT_ALLOWED:
+            return "Option can't be unset";
+        case DASH_ERROR_MISSING_ARGUMENT:
+            return "Option requires an argument";
+        case DASH_ERROR_UNEXPECTED_ARGUMENT:
+            return "Option doesn't take an argument";
+        case DASH_ERROR_ALREADY_SET:
+            return "Option was already set";
+        case DASH_ERROR_OUT_OF_MEMORY:
+            return "Out of memory";
+        case DASH_ERROR_ARENA_FULL:
+            return "Value storage is full";
+        case DASH_ERROR_RESPONSE_FILE:
+            return "Can't read response file";
+        case DASH_ERROR_RESPONSE_SYNTAX:
+            return "Unterminated quote in response file";
+        case DASH_ERROR_INVALID_VALUE:
+            return "Invalid number";
+        case DASH_ERROR_OUT_OF_RANGE:
+            return "Number out of range";
+        case DASH_ERROR_AMBIGUOUS_OPTION:
+            return "Ambiguous option";
+        case DASH_ERROR_CONFIG_FILE:
+            return "Can't read configuration file";
+        case DASH_ERROR_CONFIG_SYNTAX:
+            return "Expected key = value";
+        case DASH_ERROR_UNKNOWN_COMMAND:
+            return "Unknown command";
+        case DASH_ERROR_INVALID_SNAPSHOT:
+            return "Invalid snapshot";
+        case DASH_ERROR_SNAPSHOT_MISMATCH:
+            return "Snapshot is for another option table";
+        case DASH_ERROR_REQUIRED_OPTION:
+            return "Option is required";
+        case DASH_ERROR_EXCLUSIVE_OPTIONS:
+            return "Options can't be used together";
+        case DASH_ERROR_MISSING_DEPENDENCY:
+            return "Option requires other options";
+        case DASH_ERROR_ONE_REQUIRED:
+            return "One of the options is required";
+    }
+    return "Unknown error";
+}
+
+// Response files nested deeper than this are most likely including themselves
+#define MAX_RESPONSE_DEPTH 16
+
+typedef struct {
+    char* data;
+    size_t length;
+    size_t mapped_size;
+    int count;
+} Response_File;
+
+static bool read_response_file(Response_File* file, const char* path)
+{
+    size_t capacity = 4096;
+    size_t size = 0;
+    char* grown;
+
+    #if defined(_WIN32) || defined(WIN32)
+        FILE* stream = fopen(path, "rb");
+        size_t result;
+
+        if (stream == NULL)
+        {
+            return false;
+        }
+    #else
+        int fd = open(path, O_RDONLY);
+        struct stat status;
+        long page_size = sysconf(_SC_PAGESIZE);
+        void* reserved;
+        ssize_t result;
+
+        if (fd == -1)
+        {
+            return false;
+        }
+
+        if (fstat(fd, &status) == 0 && S_ISREG(status.st_mode) && status.st_size > 0)
+        {
+            // Reserve at least one byte past the end of the file for the last terminator,
+            // then map the file privately over it so it can be split in place
+            size = (size_t) status.st_size;
+            file->mapped_size = (size / page_size + 1) * page_size;
+            reserved = mmap(NULL, file->mapped_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (reserved != MAP_FAILED)
+            {
+                if (mmap(reserved, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, fd, 0) != MAP_FAILED)
+                {
+                    close(fd);
+                    file->data = reserved;
+                    file->length = size;
+                    return true;
+                }
+                munmap(reserved, file->mapped_size);
+            }
+            size = 0;
+        }
+    #endif
+
+    // Pipes, special files and systems without mmap are read into a single buffer
+    file->mapped_size = 0;
+    file->data = malloc(capacity);
+    while (file->data != NULL)
+    {
+        #if defined(_WIN32) || defined(WIN32)
+            result = fread(&file->data[size], 1, capacity - size - 1, stream);
+        #else
+            result = read(fd, &file->data[size], capacity - size - 1);
+            if (result == -1 && errno == EINTR)
+            {
+                continue;
+            }
+        #endif
+        if (result <= 0)
+        {
+            break;
+        }
+        size += (size_t) result;
+        if (capacity - size - 1 == 0)
+        {
+            grown = realloc(file->data, capacity * 2);
+            if (grown == NULL)
+            {
+                free(file->data);
+                file->data = NULL;
+                break;
+            }
+            file->data = grown;
+            capacity *= 2;
+        }
+    }
+    #if defined(_WIN32) || defined(WIN32)
+        fclose(stream);
+    #else
+        close(fd);
+    #endif
+    file->length = size;
+    return file->data != NULL;
+}
+
+static void release_response_file(Response_File* file)
+{
+    #if !defined(_WIN32) && !defined(WIN32)
+        if (file->mapped_size != 0)
+        {
+            munmap(file->data, file->mapped_size);
+            return;
+        }
+    #endif
+    free(file->data);
+}
+
+// Split the file in place into consecutive '\0'-terminated arguments.
+// Files containing a '\0' hold '\0'-delimited records, other files hold one argument per line,
+// and a line starting with a quote holds a quoted argument: '' is literal, "" understands backslash escapes.
+static bool split_response_file(Response_File* file)
+{
+    char* data = file->data;
+    size_t size = file->length;
+    size_t read_index = 0;
+    size_t write_index = 0;
+    const char* newline;
+    size_t line_length;
+    char quote;
+
+    data[size] = '\0';
+    file->count = 0;
+
+    if (memchr(data, '\0', size) != NULL)
+    {
+        for (size_t i = 0; i < size; i++)
+        {
+            if (data[i] == '\0')
+            {
+                file->count++;
+            }
+        }
+        // A last record without its terminator
+        if (size > 0 && data[size - 1] != '\0')
+        {
+            file->count++;
+            size++;
+        }
+        file->length = size;
+        return true;
+    }
+
+    while (read_index < size)
+    {
+        if (data[read_index] == '\n' || (data[read_index] == '\r' && data[read_index + 1] == '\n'))
+        {
+            read_index++;
+            continue;
+        }
+
+        if (data[read_index] == '"' || data[read_index] == '\'')
+        {
+            quote = data[read_index++];
+            while (data[read_index] != quote)
+            {
+                if (read_index >= size)
+                {
+                    return false;
+                }
+                if (quote == '"' && data[read_index] == '\\' && read_index + 1 < size)
+                {
+                    read_index++;
+                    switch (data[read_index])
+                    {
+                        case 'n':
+                            data[read_index] = '\n';
+                            break;
+                        case 't':
+                            data[read_index] = '\t';
+                            break;
+                        case 'r':
+                            data[read_index] = '\r';
+                            break;
+                    }
+                }
+                data[write_index++] = data[read_index++];
+            }
+            // Ignore what follows the closing quote on the same line
+            newline = memchr(&data[read_index], '\n', size - read_index);
+            read_index = newline != NULL ? (size_t) (newline - data) + 1 : size;
+        }
+        else
+        {
+            newline = memchr(&data[read_index], '\n', size - read_index);
+            line_length = newline != NULL ? (size_t) (newline - &data[read_index]) : size - read_index;
+            memmove(&data[write_index], &data[read_index], line_length);
+            read_index += line_length + 1;
+            write_index += line_length;
+            if (line_length > 0 && data[write_index - 1] == '\r')
+            {
+                write_index--;
+            }
+        }
+        data[write_index++] = '\0';
+        file->count++;
+    }
+    file->length = write_index;
+    return true;
+}
+
+static bool is_response_file(const char* argument)
+{
+    return argument[0] == '@' && argument[1] != '\0';
+}
+
+// First pass: load every response file in the order they are met and count the resulting arguments
+static int count_response_arguments(dash_Responses* responses, char* argument, int depth, bool* ended, dash_Error* error)
+{
+    Response_File* file;
+    Response_File* grown;
+    char* cursor;
+    int total = 0;
+    int count;
+
+    if (*ended || !is_response_file(argument))
+    {
+        *ended = *ended || !strcmp(argument, "--");
+        return 1;
+    }
+
+    if (depth == MAX_RESPONSE_DEPTH)
+    {
+        if (error != NULL)
+        {
+            error->code = DASH_ERROR_RESPONSE_FILE;
+        }
+        return -1;
+    }
+
+    if (responses->file_count == responses->file_capacity)
+    {
+        grown = realloc(responses->files, (responses->file_capacity * 2 + 4) * sizeof(Response_File));
+        if (grown == NULL)
+        {
+            if (error != NULL)
+            {
+                error->code = DASH_ERROR_OUT_OF_MEMORY;
+            }
+            return -1;
+        }
+        responses->files = grown;
+        responses->file_capacity = responses->file_capacity * 2 + 4;
+    }
+    file = &((Response_File*) responses->files)[responses->file_count];
+    if (!read_response_file(file, &argument[1]))
+    {
+        if (error != NULL)
+        {
+            error->code = DASH_ERROR_RESPONSE_FILE;
+        }
+        return -1;
+    }
+    responses->file_count++;
+    if (!split_response_file(file))
+    {
+        if (error != NULL)
+        {
+            error->code = DASH_ERROR_RESPONSE_SYNTAX;
+        }
+        return -1;
+    }
+
+    cursor = file->data;
+    for (int i = 0; i < file->count; i++)
+    {
+        if ((count = count_response_arguments(responses, cursor, depth + 1, ended, error)) == -1)
+        {
+            return -1;
+        }
+        total += count;
+        cursor += strlen(cursor) + 1;
+    }
+    return total;
+}
 
-    int found_structure_index = -1;
-    bool last_opt_was_unset = false;
-    bool long_opt_was_provided_with_equal = false;
+// Second pass: walk the arguments in the same order, taking files from the list filled by the first pass
+static void fill_response_arguments(dash_Responses* responses, char* argument, int* file_index, bool* ended, char** output, int* output_count)
+{
+    Response_File* file;
+    char* cursor;
+
+    if (*ended || !is_response_file(argument))
+    {
+        *ended = *ended || !strcmp(argument, "--");
+        output[(*output_count)++] = argument;
+        return;
+    }
+
+    file = &((Response_File*) responses->files)[(*file_index)++];
+    cursor = file->data;
+    for (int i = 0; i < file->count; i++)
+    {
+        fill_response_arguments(responses, cursor, file_index, ended, output, output_count);
+        cursor += strlen(cursor) + 1;
+    }
+}
+
+bool dash_expand_response_files(int* argc, char*** argv, dash_Responses* responses, dash_Error* error)
+{
+    bool ended = false;
+    bool found = false;
+    int total = 1;
+    int count;
+    int file_index = 0;
+    int output_count = 1;
+
+    responses->argv = NULL;
+    responses->files = NULL;
+    responses->file_count = 0;
+    responses->file_capacity = 0;
+    clear_error(error);
+
+    // Nothing to do, keep the original vector
+    for (int i = 1; i < *argc && strcmp((*argv)[i], "--"); i++)
+    {
+        found = found || is_response_file((*argv)[i]);
+    }
+    if (!found)
+    {
+        return true;
+    }
+
+    for (int i = 1; i < *argc; i++)
+    {
+        if ((count = count_response_arguments(responses, (*argv)[i], 0, &ended, error)) == -1)
+        {
+            // Nested files are released below, so report the argument of the outermost one
+            if (error != NULL)
+            {
+                error->argument_index = i;
+                error->argument = (*argv)[i];
+            }
+            dash_free_responses(responses);
+            return false;
+        }
+        total += count;
+    }
+
+    // The only allocation proportional to the number of arguments
+    responses->argv = malloc((total + 1) * sizeof(char*));
+    if (responses->argv == NULL)
+    {
+        if (error != NULL)
+        {
+            error->code = DASH_ERROR_OUT_OF_MEMORY;
+        }
+        dash_free_responses(responses);
+        return false;
+    }
+
+    ended = false;
+    responses->argv[0] = (*argv)[0];
+    for (int i = 1; i < *argc; i++)
+    {
+        fill_response_arguments(responses, (*argv)[i], &file_index, &ended, responses->argv, &output_count);
+    }
+    responses->argv[total] = NULL;
+
+    *argc = total;
+    *argv = responses->argv;
+    return true;
+}
+
+void dash_free_responses(dash_Responses* responses)
+{
+    for (int i = 0; i < responses->file_count; i++)
+    {
+        release_response_file(&((Response_File*) responses->files)[i]);
+    }
+    free(responses->files);
+    free(responses->argv);
+    responses->files = NULL;
+    responses->argv = NULL;
+    responses->file_count = 0;
+    responses->file_capacity = 0;
+}
+
+static bool config_error(dash_Config* config, dash_Error* error, dash_Error_Code code, const char* path, int line, int column)
+{
+    dash_config_free(config);
+    if (error != NULL)
+    {
+        error->code = code;
+        error->argument = path;
+        error->line = line;
+        error->column = column;
+    }
+    return false;
+}
 
-    bool option_should_have_argument;
+// The file is mapped privately and split in place in a single pass: keys and values are '\0'-terminated where they
+// end in the file, and the only other allocation is the array of entries. A line holding an entry takes at least
+// three bytes, so the array is sized once from the length of the file and only the pages it uses are ever touched.
+bool dash_config_load(dash_Config* config, const char* path, dash_Error* error)
+{
+    Response_File* file;
+    Config_Entry* entries;
+    int line_number = 0;
+    char* data;
+    char* line;
+    char* newline;
+    char* key;
+    char* key_end;
+    char* equal;
+    char* value;
+    char* value_end;
+
+    clear_error(error);
+    config->entries = NULL;
+    config->entry_count = 0;
+    config->file = file = calloc(1, sizeof(Response_File));
+    if (file == NULL || !read_response_file(file, path))
+    {
+        free(file);
+        config->file = NULL;
+        return config_error(config, error, DASH_ERROR_CONFIG_FILE, path, 0, 0);
+    }
+    data = file->data;
+    data[file->length] = '\0';
+    config->entries = entries = malloc((file->length / 3 + 1) * sizeof(Config_Entry));
+    if (entries == NULL)
+    {
+        return config_error(config, error, DASH_ERROR_OUT_OF_MEMORY, path, 0, 0);
+    }
+
+    for (line = data; line < data + file->length; line = newline + 1)
+    {
+        line_number++;
+        newline = memchr(line, '\n', data + file->length - line);
+        if (newline == NULL)
+        {
+            newline = data + file->length;
+        }
 
-    unsigned long argument_length;
-    unsigned long unset_argument_length;
+        // Skip blank lines and comments
+        for (key = line; *key == ' ' || *key == '\t' || *key == '\r'; key++);
+        if (key == newline || *key == '#' || *key == ';')
+        {
+            continue;
+        }
 
-    char* dest_addr;
-    char* unset_dest_addr;
-    char* short_dest_addr;
+        for (key_end = key; *key_end != '=' && *key_end != ' ' && *key_end != '\t' && *key_end != '\r' && key_end != newline; key_end++);
+        for (equal = key_end; *equal == ' ' || *equal == '\t'; equal++);
+        if (key_end == key || *equal != '=')
+        {
+            return config_error(config, error, DASH_ERROR_CONFIG_SYNTAX, path, line_number, (int) (equal - line) + 1);
+        }
+        for (value = equal + 1; *value == ' ' || *value == '\t'; value++);
+        for (value_end = newline; value_end > value && (value_end[-1] == ' ' || value_end[-1] == '\t' || value_end[-1] == '\r'); value_end--);
 
-    int c;
+        entries[config->entry_count++] = (Config_Entry) {
+            .key = key,
+            .value = value,
+            .key_length = (int) (key_end - key),
+            .line = line_number,
+            .key_column = (int) (key - line) + 1,
+            .value_column = (int) (value - line) + 1,
+        };
+        *key_end = '\0';
+        *value_end = '\0';
+    }
+    return true;
+}
 
-    while (options[structure_length].opt_name != '\0' || options[structure_length].longopt_name != NULL)
+void dash_config_free(dash_Config* config)
+{
+    if (config->file != NULL)
     {
-        // Can't dereference a NULL pointer
-        if (options[structure_length].user_pointer == NULL)
-        {
-            return false;
-        }
+        release_response_file(config->file);
+    }
+    free(config->file);
+    free(config->entries);
+    config->file = NULL;
+    config->entries = NULL;
+    config->entry_count = 0;
+}
 
-        // We put each pointer to NULL so we can know if they were allocated or not int the future.
-        if(options[structure_length].param_name == NULL)
+// A name of a rule as it is written on the command line, --name or -n
+static int find_rule_option(const dash_Longopt* options, int structure_length, const char* name, size_t length)
+{
+    for (int i = 0; i < structure_length; i++)
+    {
+        if (length == 2 && name[0] == '-' && name[1] != '-' && options[i].opt_name == name[1])
         {
-            *((bool*)options[structure_length].user_pointer) = false;
+            return i;
         }
-        else
+        if (length > 2 && name[0] == '-' && name[1] == '-' && options[i].longopt_name != NULL
+            && strlen(options[i].longopt_name) == length - 2 && !strncmp(options[i].longopt_name, name + 2, length - 2))
         {
-            *((char**)options[structure_length].user_pointer) = NULL;
+            return i;
         }
+    }
+    return -1;
+}
+
+// Names are only looked up here, each rule becomes two bitsets over the options of the table
+bool dash_constraints_init(dash_Constraints* constraints, const dash_Longopt* options, const dash_Constraint* rules, dash_Error* error)
+{
+    int structure_length = 0;
+    int name_count;
+    int option;
+    const char* name;
+    size_t length;
+    uint64_t* mask;
+
+    clear_error(error);
+    constraints->rules = rules;
+    constraints->rule_count = 0;
+    constraints->masks = NULL;
+    while (options[structure_length].opt_name != '\0' || options[structure_length].longopt_name != NULL)
+    {
         structure_length++;
     }
+    while (rules[constraints->rule_count].options != NULL)
+    {
+        constraints->rule_count++;
+    }
+    constraints->word_count = (structure_length + 63) / 64;
+    constraints->masks = calloc(2 * (size_t) constraints->rule_count * constraints->word_count + 1, sizeof(uint64_t));
+    if (constraints->masks == NULL)
+    {
+        return report_error(error, DASH_ERROR_OUT_OF_MEMORY, -1);
+    }
 
-    for (int i = 1; i < *argc; i++)
+    for (int r = 0; r < constraints->rule_count; r++)
     {
-        // Previous flag did not specify argument
-        if (found_structure_index != -1 && !long_opt_was_provided_with_equal)
+        mask = &constraints->masks[2 * (size_t) r * constraints->word_count];
+        name_count = 0;
+        for (name = rules[r].options; *name != '\0'; name += length)
         {
-            // We need an argument
-            if (options[found_structure_index].param_name != NULL && !options[found_structure_index].param_optional)
+            for (; *name == ' '; name++);
+            for (length = 0; name[length] != '\0' && name[length] != ' '; length++);
+            if (length == 0)
             {
-                if (argv[i][0] == '-')
-                {
-                    return false;
-                }
-                argument_length = strlen(argv[i]);
-                if (options[found_structure_index].allow_flag_unset)
-                {
-                    argument_length += 1;
-                }
-                if (* ((char**) options[found_structure_index].user_pointer) != NULL)
-                {
-                    return false;
-                }
-                *((char**) options[found_structure_index].user_pointer) = malloc((argument_length + 1) * sizeof(char));
-                if(*((char**) options[found_structure_index].user_pointer) == NULL)
-                {
-                    return false;
-                }
-                dest_addr = * ((char**) options[found_structure_index].user_pointer);
-                strcpy(&dest_addr[options[found_structure_index].allow_flag_unset], argv[i]);
-                if (options[found_structure_index].allow_flag_unset)
-                {
-                    dest_addr[0] = last_opt_was_unset ? '+' : '-';
-                }
-                argv[i] = NULL;
-                found_structure_index = -1;
                 continue;
             }
-            // Try to search for an argument
-            else if (options[found_structure_index].param_name != NULL)
+            if ((option = find_rule_option(options, structure_length, name, length)) == -1)
             {
-                if (argv[i][0] != '-')
-                {
-                    argument_length = strlen(argv[i]);
-                    if (options[found_structure_index].allow_flag_unset)
-                    {
-                        argument_length += 1;
-                    }
-                    if (* ((char**) options[found_structure_index].user_pointer) != NULL)
-                    {
-                        return false;
-                    }
-                    *((char**) options[found_structure_index].user_pointer) = malloc((argument_length + 1) * sizeof(char));
-                    if(*((char**) options[found_structure_index].user_pointer) == NULL)
-                    {
-                        return false;
-                    }
-                    dest_addr = * ((char**) options[found_structure_index].user_pointer);
-                    strcpy(&dest_addr[options[found_structure_index].allow_flag_unset], argv[i]);
-                    if (options[found_structure_index].allow_flag_unset)
-                    {
-                        dest_addr[0] = last_opt_was_unset ? '+' : '-';
-                    }
-                    argv[i] = NULL;
-                    found_structure_index = -1;
-                    continue;
-                }
-                else
-                {
-                    *((char**) options[found_structure_index].user_pointer) = malloc((1 + options[found_structure_index].allow_flag_unset) * sizeof(char));
-                    if(*((char**) options[found_structure_index].user_pointer) == NULL)
-                    {
-                        return false;
-                    }
-                    (* ((char**) options[found_structure_index].user_pointer))[options[found_structure_index].allow_flag_unset] = '\0';
-                    if (options[found_structure_index].allow_flag_unset)
-                    {
-                        (* ((char**) options[found_structure_index].user_pointer))[0] = last_opt_was_unset ? '+' : '-';
-                    }
-                }
+                dash_constraints_free(constraints);
+                return report_constraint(error, &(dash_Constraints) {.rules = rules}, r, DASH_ERROR_UNKNOWN_OPTION, -1);
             }
+            // The first option of DASH_RULE_REQUIRES requires the others
+            set_option_bit(rules[r].rule == DASH_RULE_REQUIRES && name_count > 0 ? mask + constraints->word_count : mask, option, true);
+            name_count++;
         }
-
-        long_opt_was_provided_with_equal = false;
-        found_structure_index = -1;
-
-        // Check if argument begins with a dash or a plus
-        if (argv[i][0] != '-' && argv[i][0] != '+')
+        if (name_count < (rules[r].rule == DASH_RULE_REQUIRES ? 2 : 1) || rules[r].rule < DASH_RULE_REQUIRED || rules[r].rule > DASH_RULE_ONE_OF)
         {
-            argument_non_option_count += 1;
-            continue;
+            dash_constraints_free(constraints);
+            return report_constraint(error, &(dash_Constraints) {.rules = rules}, r, DASH_ERROR_INVALID_TABLE, -1);
         }
+    }
+    return true;
+}
+
+void dash_constraints_free(dash_Constraints* constraints)
+{
+    free(constraints->masks);
+    constraints->masks = NULL;
+    constraints->rule_count = 0;
+}
 
-        // If argument begins with a plus, unset shortopt
-        if (argv[i][0] == '+')
+bool dash_get_stats(dash_Stats* stats)
+{
+    #ifdef DASH_STATS
+        // Each counter is read on its own, a parse finishing meanwhile may only be partly included
+        stats->parses = stats_load(&stats_total.parses);
+        stats->tokens = stats_load(&stats_total.tokens);
+        stats->entries_compared = stats_load(&stats_total.entries_compared);
+        stats->string_compares = stats_load(&stats_total.string_compares);
+        stats->bytes_copied = stats_load(&stats_total.bytes_copied);
+        stats->allocations = stats_load(&stats_total.allocations);
+        for (int i = 0; i < DASH_PHASE_COUNT; i++)
         {
-            last_opt_was_unset = true;
-            c = 1;
-            option_should_have_argument = false;
-            while (argv[i][c] != '\0')
-            {
-                if (option_should_have_argument == true)
-                {
-                    argument_length = strlen(&argv[i][c]);
-                    if (options[found_structure_index].allow_flag_unset)
-                    {
-                        argument_length += 1;
-                    }
-                    if (* ((char**) options[found_structure_index].user_pointer) != NULL)
-                    {
-                        return false;
-                    }
-                    * ((char**) options[found_structure_index].user_pointer) = malloc((argument_length + 1) * sizeof(char));
-                    if(*((char**) options[found_structure_index].user_pointer) == NULL)
-                    {
-                        return false;
-                    }
-                    unset_dest_addr = * ((char**) options[found_structure_index].user_pointer);
-                    strcpy(&unset_dest_addr[options[found_structure_index].allow_flag_unset], &argv[i][c]);
-                    if (options[found_structure_index].allow_flag_unset)
-                    {
-                        unset_dest_addr[0] = '+';
-                    }
-                    found_structure_index = -1;
-                    break;
-                }
-                if ((found_structure_index = assign_shortopt(argv[i][c], options, structure_length, true)) == -1)
-                {
-                    return false;
-                }
-                option_should_have_argument = (options[found_structure_index].param_name != NULL && options[found_structure_index].param_optional);
-                c++;
-            }
-            argv[i] = NULL;
-            continue;
+            stats->nanoseconds[i] = stats_load(&stats_total.nanoseconds[i]);
         }
+        return true;
+    #else
+        memset(stats, 0, sizeof(dash_Stats));
+        return false;
+    #endif
+}
+
+void dash_reset_stats(void)
+{
+    #ifdef DASH_STATS
+        memset(&stats_total, 0, sizeof(dash_Stats));
+    #endif
+}
+
+void dash_set_trace(dash_Trace trace, void* user_data)
+{
+    #ifdef DASH_STATS
+        stats_trace = trace;
+        stats_trace_data = user_data;
+    #else
+        (void) trace;
+        (void) user_data;
+    #endif
+}
+
+// Command lines are handed out in chunks so workers rarely touch the shared counters
+#define BATCH_CHUNK 16
+
+typedef struct {
+    volatile int next;
+    int end;
+    // Keep each worker's counter on its own cache line
+    char padding[64 - 2 * sizeof(int)];
+} Batch_Range;
+
+// malloc only aligns to 16 bytes, the padding alone wouldn't keep two counters apart
+static Batch_Range* allocate_ranges(int count)
+{
+    #if defined(_WIN32) || defined(WIN32)
+        return _aligned_malloc(count * sizeof(Batch_Range), 64);
+    #else
+        return aligned_alloc(64, count * sizeof(Batch_Range));
+    #endif
+}
+
+static void free_ranges(Batch_Range* ranges)
+{
+    #if defined(_WIN32) || defined(WIN32)
+        _aligned_free(ranges);
+    #else
+        free(ranges);
+    #endif
+}
+
+typedef struct {
+    const dash_Parser* parser;
+    int count;
+    const int* argcs;
+    char* const* const* argvs;
+    // Only set when parsing a file, its command lines are split by the workers
+    dash_Batch* batch;
+    char** lines;
+    dash_Result* results;
+    Batch_Range* ranges;
+    int worker_count;
+    volatile int failed;
+} Batch_Job;
+
+typedef struct {
+    Batch_Job* job;
+    int worker;
+} Batch_Worker;
+
+static int fetch_add(volatile int* value, int amount)
+{
+    #if defined(_WIN32) || defined(WIN32)
+        return InterlockedExchangeAdd((volatile LONG*) value, amount);
+    #else
+        return __atomic_fetch_add(value, amount, __ATOMIC_RELAXED);
+    #endif
+}
+
+static int processor_count(void)
+{
+    #if defined(_WIN32) || defined(WIN32)
+        SYSTEM_INFO info;
+
+        GetSystemInfo(&info);
+        return (int) info.dwNumberOfProcessors;
+    #else
+        long count = sysconf(_SC_NPROCESSORS_ONLN);
 
-        last_opt_was_unset = false;
+        return count > 0 ? (int) count : 1;
+    #endif
+}
+
+// Split a command line in place into consecutive '\0'-terminated arguments, like a shell would without expansions:
+// blanks separate arguments, '' is literal, "" and unquoted text understand backslash escapes
+static int split_command_line(char* line)
+{
+    char* read = line;
+    char* write = line;
+    int count = 0;
+    bool last;
+    char quote;
 
-        // Double dash, long opt
-        if (argv[i][1] == '-')
+    while (true)
+    {
+        while (*read == ' ' || *read == '\t' || *read == '\r')
         {
-            // Only double dash, end of parsing arguments
-            if (argv[i][2] == '\0')
-            {
-                argument_non_option_count += *argc - i - 1;
-                argv[i] = NULL;
-                goto REORGANIZE;
-            }
-            if ((found_structure_index = assign_longopt(&argv[i], options, structure_length, &long_opt_was_provided_with_equal)) == -1)
-            {
-                return false;
-            }
+            read++;
         }
-        // Single dash, ignore (will be used as stdin)
-        else if (argv[i][1] == '\0')
+        if (*read == '\0')
         {
-            argument_non_option_count += 1;
-            continue;
+            return count;
         }
-        // Short opt
-        else
+
+        while (*read != '\0' && *read != ' ' && *read != '\t' && *read != '\r')
         {
-            c = 1;
-            option_should_have_argument = false;
-            while (argv[i][c] != '\0')
+            if (*read == '\'' || *read == '"')
             {
-                if (option_should_have_argument == true)
+                quote = *read++;
+                while (*read != quote)
                 {
-                    unset_argument_length = strlen(&argv[i][c]);
-                    if (options[found_structure_index].allow_flag_unset)
-                    {
-                        unset_argument_length += 1;
-                    }
-                    if (* ((char**) options[found_structure_index].user_pointer) != NULL)
+                    if (*read == '\0')
                     {
-                        return false;
+                        return -1;
                     }
-                    * ((char**) options[found_structure_index].user_pointer) = malloc((unset_argument_length + 1) * sizeof(char));
-                    short_dest_addr = * ((char**) options[found_structure_index].user_pointer);
-                    strcpy(&short_dest_addr[options[found_structure_index].allow_flag_unset], &argv[i][c]);
-                    if (options[found_structure_index].allow_flag_unset)
+                    if (quote == '"' && *read == '\\' && read[1] != '\0')
                     {
-                        short_dest_addr[0] = '-';
+                        read++;
                     }
-                    found_structure_index = -1;
-                    break;
+                    *write++ = *read++;
                 }
-                if ((found_structure_index = assign_shortopt(argv[i][c], options, structure_length, false)) == -1)
+                read++;
+            }
+            else
+            {
+                if (*read == '\\' && read[1] != '\0')
                 {
-                    return false;
+                    read++;
                 }
-                option_should_have_argument = (options[found_structure_index].param_name != NULL && !options[found_structure_index].param_optional);
-                c++;
+                *write++ = *read++;
             }
-            argv[i] = NULL;
+        }
+
+        // The terminator may land on the separator, step over it first
+        last = *read == '\0';
+        if (!last)
+        {
+            read++;
+        }
+        *write++ = '\0';
+        count++;
+        if (last)
+        {
+            return count;
         }
     }
+}
 
-REORGANIZE:
+static void parse_batch_item(Batch_Job* job, int item)
+{
+    dash_Result* result = &job->results[item];
+    char* cursor;
+    char** argv;
+    int argc;
 
-    if (found_structure_index != -1 && options[found_structure_index].param_optional && options[found_structure_index].param_name != NULL && !long_opt_was_provided_with_equal)
+    if (!dash_result_init(result, job->parser))
     {
-        if (* ((char**) options[found_structure_index].user_pointer) != NULL)
-        {
-            return false;
-        }
-        *((char**) options[found_structure_index].user_pointer) = malloc((1 + options[found_structure_index].allow_flag_unset) * sizeof(char));
-        if(*((char**) options[found_structure_index].user_pointer) == NULL)
+        report_error(&result->error, DASH_ERROR_OUT_OF_MEMORY, -1);
+        fetch_add(&job->failed, 1);
+        return;
+    }
+
+    if (job->lines != NULL)
+    {
+        argc = split_command_line(job->lines[item]);
+        argv = argc == -1 ? NULL : malloc((argc + 1) * sizeof(char*));
+        if (argv == NULL)
         {
-            return false;
+            report_error(&result->error, argc == -1 ? DASH_ERROR_RESPONSE_SYNTAX : DASH_ERROR_OUT_OF_MEMORY, -1);
+            fetch_add(&job->failed, 1);
+            return;
         }
-        (* ((char**) options[found_structure_index].user_pointer))[options[found_structure_index].allow_flag_unset] = '\0';
-        if (options[found_structure_index].allow_flag_unset)
+        cursor = job->lines[item];
+        for (int i = 0; i < argc; i++)
         {
-            (* ((char**) options[found_structure_index].user_pointer))[0] = last_opt_was_unset ? '+' : '-';
+            argv[i] = cursor;
+            cursor += strlen(cursor) + 1;
         }
+        argv[argc] = NULL;
+        job->batch->argcs[item] = argc;
+        job->batch->argvs[item] = argv;
     }
 
-    if (found_structure_index != -1 && options[found_structure_index].param_name != NULL && !options[found_structure_index].param_optional && !long_opt_was_provided_with_equal)
+    if (!dash_parse(job->parser, job->argcs[item], job->argvs[item], result))
     {
-        return false;
+        fetch_add(&job->failed, 1);
     }
+}
 
-    for (int i = 1; i < *argc; i++)
+// Drain our own range first, then steal chunks from the other workers' ranges
+static void run_batch_worker(Batch_Job* job, int worker)
+{
+    Batch_Range* range;
+    int start;
+    int end;
+
+    for (int i = 0; i < job->worker_count; i++)
     {
-        if (argv[i] != NULL)
+        range = &job->ranges[(worker + i) % job->worker_count];
+        while ((start = fetch_add(&range->next, BATCH_CHUNK)) < range->end)
         {
-            argv[argument_non_option_index] = argv[i];
-            if (i != argument_non_option_index++)
+            end = start + BATCH_CHUNK < range->end ? start + BATCH_CHUNK : range->end;
+            for (int item = start; item < end; item++)
             {
-                argv[i] = NULL;
+                parse_batch_item(job, item);
             }
         }
     }
+}
 
-    *argc = argument_non_option_count;
+#if defined(_WIN32) || defined(WIN32)
+static DWORD WINAPI batch_thread(LPVOID argument)
+#else
+static void* batch_thread(void* argument)
+#endif
+{
+    Batch_Worker* worker = argument;
+
+    run_batch_worker(worker->job, worker->worker);
+    return 0;
+}
+
+static bool run_batch(Batch_Job* job, int thread_count)
+{
+    Batch_Worker* workers;
+    bool* started;
+    #if defined(_WIN32) || defined(WIN32)
+        HANDLE* threads;
+    #else
+        pthread_t* threads;
+    #endif
+
+    if (thread_count <= 0)
+    {
+        thread_count = processor_count();
+    }
+    // Don't start threads that would only find empty ranges
+    if (thread_count > (job->count + BATCH_CHUNK - 1) / BATCH_CHUNK)
+    {
+        thread_count = (job->count + BATCH_CHUNK - 1) / BATCH_CHUNK;
+    }
+    if (thread_count < 1)
+    {
+        thread_count = 1;
+    }
+
+    job->worker_count = thread_count;
+    job->failed = 0;
+    job->ranges = allocate_ranges(thread_count);
+    workers = malloc(thread_count * sizeof(Batch_Worker));
+    started = calloc(thread_count, sizeof(bool));
+    threads = malloc(thread_count * sizeof(*threads));
+    if (job->ranges == NULL || workers == NULL || started == NULL || threads == NULL)
+    {
+        free_ranges(job->ranges);
+        free(workers);
+        free(started);
+        free(threads);
+        return false;
+    }
+
+    for (int i = 0; i < thread_count; i++)
+    {
+        job->ranges[i].next = (int) ((long long) job->count * i / thread_count);
+        job->ranges[i].end = (int) ((long long) job->count * (i + 1) / thread_count);
+        workers[i].job = job;
+        workers[i].worker = i;
+    }
+
+    // The calling thread is worker 0, the range of a thread that can't be started is stolen by the others
+    for (int i = 1; i < thread_count; i++)
+    {
+        #if defined(_WIN32) || defined(WIN32)
+            threads[i] = CreateThread(NULL, 0, batch_thread, &workers[i], 0, NULL);
+            started[i] = threads[i] != NULL;
+        #else
+            started[i] = pthread_create(&threads[i], NULL, batch_thread, &workers[i]) == 0;
+        #endif
+    }
+    run_batch_worker(job, 0);
+    for (int i = 1; i < thread_count; i++)
+    {
+        if (started[i])
+        {
+            #if defined(_WIN32) || defined(WIN32)
+                WaitForSingleObject(threads[i], INFINITE);
+                CloseHandle(threads[i]);
+            #else
+                pthread_join(threads[i], NULL);
+            #endif
+        }
+    }
 
+    free_ranges(job->ranges);
+    free(workers);
+    free(started);
+    free(threads);
     return true;
 }
 
-void dash_free(dash_Longopt* options)
+bool dash_parse_batch(const dash_Parser* parser, int count, const int argcs[], char* const* const argvs[], dash_Result results[], int thread_count)
 {
-    int structure_length = 0;
-    while (options[structure_length].opt_name != '\0' || options[structure_length].longopt_name != NULL)
+    Batch_Job job = {
+        .parser = parser,
+        .count = count,
+        .argcs = argcs,
+        .argvs = argvs,
+        .results = results
+    };
+
+    if (!run_batch(&job, thread_count))
     {
-        // Can't dereference a NULL pointer
-        if (options[structure_length].user_pointer == NULL)
+        // Still give every command line a result
+        for (int i = 0; i < count; i++)
+        {
+            parse_batch_item(&job, i);
+        }
+    }
+    return job.failed == 0;
+}
+
+bool dash_parse_batch_file(const dash_Parser* parser, const char* path, dash_Batch* batch, int thread_count)
+{
+    Response_File* file;
+    Batch_Job job = {.parser = parser, .batch = batch};
+    char* data;
+    char* line;
+    char* newline;
+    int line_number = 0;
+    int capacity = 0;
+    int* lines;
+    char** starts;
+
+    batch->count = 0;
+    batch->failed = 0;
+    batch->argcs = NULL;
+    batch->argvs = NULL;
+    batch->lines = NULL;
+    batch->results = NULL;
+    batch->file = file = calloc(1, sizeof(Response_File));
+    if (file == NULL || !read_response_file(file, path))
+    {
+        free(file);
+        batch->file = NULL;
+        return false;
+    }
+    data = file->data;
+    data[file->length] = '\0';
+
+    // One sequential pass finds the command lines, everything else is left to the workers
+    for (line = data; line < data + file->length; line = newline + 1)
+    {
+        line_number++;
+        newline = memchr(line, '\n', data + file->length - line);
+        if (newline == NULL)
+        {
+            newline = data + file->length;
+        }
+        *newline = '\0';
+
+        // Skip blank lines and comments
+        line += strspn(line, " \t\r");
+        if (*line == '\0' || *line == '#')
         {
             continue;
         }
 
-        // We put each pointer to NULL so we can know if they were allocated or not int the future.
-        if(options[structure_length].param_name != NULL)
+        if (batch->count == capacity)
         {
-            char** p = (char**)options[structure_length].user_pointer;
-            free(*p);
-            *p = NULL;
+            capacity = capacity * 2 + 64;
+            lines = realloc(batch->lines, capacity * sizeof(int));
+            if (lines != NULL)
+            {
+                batch->lines = lines;
+            }
+            starts = realloc(job.lines, capacity * sizeof(char*));
+            if (starts != NULL)
+            {
+                job.lines = starts;
+            }
+            if (lines == NULL || starts == NULL)
+            {
+                free(job.lines);
+                dash_free_batch(batch);
+                return false;
+            }
         }
-        structure_length++;
+        batch->lines[batch->count] = line_number;
+        job.lines[batch->count++] = line;
+    }
+
+    batch->argcs = calloc(batch->count + 1, sizeof(int));
+    batch->argvs = calloc(batch->count + 1, sizeof(char**));
+    batch->results = calloc(batch->count + 1, sizeof(dash_Result));
+    if (batch->argcs == NULL || batch->argvs == NULL || batch->results == NULL)
+    {
+        free(job.lines);
+        dash_free_batch(batch);
+        return false;
+    }
+
+    job.count = batch->count;
+    job.argcs = batch->argcs;
+    job.argvs = (char* const* const*) batch->argvs;
+    job.results = batch->results;
+    if (!run_batch(&job, thread_count))
+    {
+        for (int i = 0; i < job.count; i++)
+        {
+            parse_batch_item(&job, i);
+        }
+    }
+    batch->failed = job.failed;
+    free(job.lines);
+    return true;
+}
+
+void dash_free_batch(dash_Batch* batch)
+{
+    for (int i = 0; batch->results != NULL && i < batch->count; i++)
+    {
+        dash_result_free(&batch->results[i]);
+        free(batch->argvs[i]);
+    }
+    if (batch->file != NULL)
+    {
+        release_response_file(batch->file);
     }
-}
\ No newline at end of file
+    free(batch->file);
+    free(batch->argcs);
+    free(batch->argvs);
+    free(batch->lines);
+    free(batch->results);
+    batch->count = 0;
+    batch->failed = 0;
+    batch->file = NULL;
+    batch->argcs = NULL;
+    batch->argvs = NULL;
+    batch->lines = NULL;
+    batch->results = NULL;
+}
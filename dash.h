@@ -13,8 +13,25 @@ THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR I
 
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
 
 
+typedef enum {
+    DASH_TYPE_STRING,
+    DASH_TYPE_INT64,
+    DASH_TYPE_UINT64,
+    DASH_TYPE_DOUBLE,
+    DASH_TYPE_SIZE,
+    DASH_TYPE_DURATION,
+    DASH_TYPE_LIST,
+    DASH_TYPE_COUNT
+} dash_Type;
+
 typedef struct {
     char opt_name;
     bool allow_flag_unset;
@@ -23,11 +40,299 @@ typedef struct {
     const char* longopt_name;
     const char* description;
     void* user_pointer;
+    bool* unset_pointer;
+    dash_Type type;
+    const char* env_name;
 } dash_Longopt;
 
+typedef struct {
+    char** values;
+    int count;
+    int capacity;
+} dash_List;
+
+typedef union {
+    int64_t int64;
+    uint64_t uint64;
+    double real;
+} dash_Number;
+
+typedef struct {
+    dash_Longopt* options;
+    int structure_length;
+    int short_options[256];
+    int* long_options;
+    unsigned* long_hashes;
+    size_t long_mask;
+    int* long_sorted;
+    int long_count;
+    void* prefix_nodes;
+    unsigned char* prefix_labels;
+    uint64_t* long_signatures;
+    void* hot;
+    uint64_t table_hash;
+} dash_Index;
+
+typedef struct {
+    char* buffer;
+    size_t size;
+    size_t used;
+    void* blocks;
+    bool growable;
+} dash_Arena;
+
+typedef enum {
+    DASH_ERROR_NONE,
+    DASH_ERROR_INVALID_TABLE,
+    DASH_ERROR_UNKNOWN_OPTION,
+    DASH_ERROR_UNSET_NOT_ALLOWED,
+    DASH_ERROR_MISSING_ARGUMENT,
+    DASH_ERROR_UNEXPECTED_ARGUMENT,
+    DASH_ERROR_ALREADY_SET,
+    DASH_ERROR_OUT_OF_MEMORY,
+    DASH_ERROR_ARENA_FULL,
+    DASH_ERROR_RESPONSE_FILE,
+    DASH_ERROR_RESPONSE_SYNTAX,
+    DASH_ERROR_INVALID_VALUE,
+    DASH_ERROR_OUT_OF_RANGE,
+    DASH_ERROR_AMBIGUOUS_OPTION,
+    DASH_ERROR_CONFIG_FILE,
+    DASH_ERROR_CONFIG_SYNTAX,
+    DASH_ERROR_UNKNOWN_COMMAND,
+    DASH_ERROR_INVALID_SNAPSHOT,
+    DASH_ERROR_SNAPSHOT_MISMATCH,
+    DASH_ERROR_REQUIRED_OPTION,
+    DASH_ERROR_EXCLUSIVE_OPTIONS,
+    DASH_ERROR_MISSING_DEPENDENCY,
+    DASH_ERROR_ONE_REQUIRED
+} dash_Error_Code;
+
+typedef struct {
+    dash_Error_Code code;
+    int option_index;
+    int argument_index;
+    const char* argument;
+    const int* candidates;
+    int candidate_count;
+    int suggestion;
+    int line;
+    int column;
+    int constraint;
+} dash_Error;
+
+enum dash_Flags {
+    DASH_ZERO_COPY = 1 << 0,
+    DASH_ABBREVIATIONS = 1 << 1
+};
+
+typedef enum {
+    DASH_SHELL_BASH,
+    DASH_SHELL_ZSH
+} dash_Shell;
+
+typedef struct {
+    void* file;
+    void* entries;
+    int entry_count;
+} dash_Config;
+
+typedef enum {
+    DASH_RULE_REQUIRED,
+    DASH_RULE_EXCLUSIVE,
+    DASH_RULE_REQUIRES,
+    DASH_RULE_ONE_OF
+} dash_Rule;
+
+typedef struct {
+    dash_Rule rule;
+    const char* options;
+} dash_Constraint;
+
+typedef struct {
+    const dash_Constraint* rules;
+    int rule_count;
+    int word_count;
+    uint64_t* masks;
+} dash_Constraints;
+
+typedef struct {
+    const dash_Index* index;
+    unsigned flags;
+    dash_Arena* arena;
+    dash_Error* error;
+    const dash_Config* config;
+    const dash_Constraints* constraints;
+} dash_Settings;
+
+typedef struct {
+    const dash_Longopt* options;
+    dash_Index index;
+    unsigned flags;
+    const dash_Config* config;
+    const dash_Constraints* constraints;
+} dash_Parser;
+
+typedef struct {
+    const char* value;
+    bool present;
+    bool unset;
+    dash_Number number;
+    dash_List list;
+} dash_Value;
+
+typedef struct {
+    dash_Value* values;
+    int option_count;
+    char** arguments;
+    int argument_count;
+    int argument_capacity;
+    dash_Error error;
+} dash_Result;
+
+typedef struct {
+    const char* name;
+    const char* description;
+    dash_Longopt* options;
+} dash_Command;
+
+typedef struct {
+    dash_Longopt* options;
+    const dash_Command* commands;
+    int command_count;
+    int* slots;
+    unsigned* hashes;
+    size_t mask;
+    dash_Index* indexes;
+    bool* indexed;
+} dash_Commands;
+
+typedef struct {
+    const dash_Longopt* options;
+    const dash_Index* index;
+    int structure_length;
+    unsigned flags;
+    int argc;
+    char* const* argv;
+    int argument;
+    int position;
+    bool unset;
+    bool ended;
+    dash_Error error;
+} dash_Iterator;
+
+typedef struct {
+    int option_index;
+    int argument_index;
+    const char* value;
+    bool unset;
+} dash_Item;
+
+typedef struct {
+    int count;
+    int failed;
+    int* argcs;
+    char*** argvs;
+    int* lines;
+    dash_Result* results;
+    void* file;
+} dash_Batch;
+
+typedef struct {
+    char* text;
+    size_t length;
+} dash_Usage;
+
+typedef enum {
+    DASH_PHASE_INIT,
+    DASH_PHASE_MATCH,
+    DASH_PHASE_COPY,
+    DASH_PHASE_COMPACT,
+    DASH_PHASE_USAGE,
+    DASH_PHASE_FREE,
+    DASH_PHASE_COUNT
+} dash_Phase;
+
+typedef struct {
+    uint64_t parses;
+    uint64_t tokens;
+    uint64_t entries_compared;
+    uint64_t string_compares;
+    uint64_t bytes_copied;
+    uint64_t allocations;
+    uint64_t nanoseconds[DASH_PHASE_COUNT];
+} dash_Stats;
+
+typedef void (*dash_Trace)(const dash_Stats* stats, void* user_data);
+
+typedef struct {
+    char** argv;
+    void* files;
+    int file_count;
+    int file_capacity;
+} dash_Responses;
+
 bool dash_arg_parser(int* argc, char* argv[], dash_Longopt* options);
 void dash_print_usage(const char* argv0, const char* header, const char* footer, const char* required_arguments[], const dash_Longopt* options, FILE* output_file);
+size_t dash_format_usage(char* buffer, size_t size, const char* argv0, const char* header, const char* footer, const char* required_arguments[], const dash_Longopt* options, bool use_colors);
+bool dash_usage_build(dash_Usage* usage, const char* argv0, const char* header, const char* footer, const char* required_arguments[], const dash_Longopt* options, bool use_colors);
+bool dash_usage_write(const dash_Usage* usage, int fd);
+void dash_usage_free(dash_Usage* usage);
 void dash_print_summary(int argc, char** argv, const dash_Longopt* options, FILE* output_file);
 void dash_free(dash_Longopt* options);
 
+bool dash_compile_options(dash_Index* index, dash_Longopt* options);
+bool dash_arg_parser_compiled(int* argc, char* argv[], const dash_Index* index);
+void dash_free_index(dash_Index* index);
+
+bool dash_arg_parser_ex(int* argc, char* argv[], dash_Longopt* options, const dash_Settings* settings);
+void dash_free_ex(dash_Longopt* options, const dash_Settings* settings);
+bool dash_reparse(int* argc, char* argv[], dash_Longopt* options, const dash_Settings* settings, uint64_t* changed);
+size_t dash_snapshot(void* buffer, size_t size, const dash_Longopt* options);
+bool dash_restore(void* buffer, size_t size, dash_Longopt* options, const dash_Settings* settings);
+
+bool dash_parser_init(dash_Parser* parser, const dash_Longopt* options);
+void dash_parser_free(dash_Parser* parser);
+bool dash_result_init(dash_Result* result, const dash_Parser* parser);
+bool dash_parse(const dash_Parser* parser, int argc, char* const argv[], dash_Result* result);
+void dash_result_free(dash_Result* result);
+
+size_t dash_format_completions(char* buffer, size_t size, const char* line, size_t position, const dash_Longopt* options, const dash_Settings* settings);
+void dash_print_completions(const char* line, size_t position, const dash_Longopt* options, const dash_Settings* settings, FILE* output_file);
+size_t dash_format_completion_script(char* buffer, size_t size, const char* program, dash_Shell shell, const dash_Longopt* options);
+bool dash_print_completion_script(const char* program, dash_Shell shell, const dash_Longopt* options, FILE* output_file);
+
+bool dash_commands_init(dash_Commands* commands, dash_Longopt* options, const dash_Command* command_table);
+void dash_commands_free(dash_Commands* commands);
+bool dash_parse_command(dash_Commands* commands, int* argc, char* argv[], const dash_Command** command, const dash_Settings* settings);
+void dash_print_commands(const char* argv0, const char* header, const char* footer, const dash_Commands* commands, FILE* output_file);
+void dash_print_command_usage(const char* argv0, const char* header, const char* footer, const char* required_arguments[], const dash_Command* command, FILE* output_file);
+
+void dash_begin(dash_Iterator* iterator, int argc, char* const argv[], const dash_Longopt* options, const dash_Settings* settings);
+bool dash_next(dash_Iterator* iterator, dash_Item* item);
+
+bool dash_parse_batch(const dash_Parser* parser, int count, const int argcs[], char* const* const argvs[], dash_Result results[], int thread_count);
+bool dash_parse_batch_file(const dash_Parser* parser, const char* path, dash_Batch* batch, int thread_count);
+void dash_free_batch(dash_Batch* batch);
+
+void dash_arena_init(dash_Arena* arena, void* buffer, size_t size);
+void dash_arena_release(dash_Arena* arena);
+const char* dash_error_message(const dash_Error* error);
+
+bool dash_expand_response_files(int* argc, char*** argv, dash_Responses* responses, dash_Error* error);
+void dash_free_responses(dash_Responses* responses);
+
+bool dash_config_load(dash_Config* config, const char* path, dash_Error* error);
+void dash_config_free(dash_Config* config);
+
+bool dash_constraints_init(dash_Constraints* constraints, const dash_Longopt* options, const dash_Constraint* rules, dash_Error* error);
+void dash_constraints_free(dash_Constraints* constraints);
+
+bool dash_get_stats(dash_Stats* stats);
+void dash_reset_stats(void);
+void dash_set_trace(dash_Trace trace, void* user_data);
+
+#ifdef __cplusplus
+}
+#endif
+
 #endif
@@ -0,0 +1,383 @@
+/*
+Copyright 2024 Valentin Foulon
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the “Software”), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef DASH_HPP
+#define DASH_HPP
+
+// Option tables for C++17, checked and indexed at compile time, then parsed by dash_arg_parser_ex
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+#include "dash.h"
+
+namespace dash
+{
+
+namespace detail
+{
+
+// A table is only checked when it is a constant expression, these are called from the checks that fail
+// so the compiler names the problem in its error
+void duplicate_short_name();
+void duplicate_long_name();
+void long_name_with_equal();
+void option_without_name();
+void optional_parameter_without_parameter();
+void type_does_not_match_member();
+
+template <typename Pointer>
+struct Member_Traits;
+
+template <typename Struct, typename Value>
+struct Member_Traits<Value Struct::*>
+{
+    using struct_type = Struct;
+    using value_type = Value;
+};
+
+template <auto Member>
+using Struct_Of = typename Member_Traits<decltype(Member)>::struct_type;
+
+template <auto Member>
+using Value_Of = typename Member_Traits<decltype(Member)>::value_type;
+
+// Same FNV-1a as the C index, which reads the tables built here
+constexpr unsigned hash_name(const char* name)
+{
+    unsigned hash = 2166136261u;
+    for (; *name != '\0'; name++)
+    {
+        hash ^= (unsigned char) *name;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+constexpr bool same_name(const char* first, const char* second)
+{
+    for (; *first != '\0' && *first == *second; first++, second++);
+    return *first == *second;
+}
+
+constexpr bool has_equal(const char* name)
+{
+    for (; *name != '\0'; name++)
+    {
+        if (*name == '=')
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Load factor under one half, like dash_compile_options
+constexpr std::size_t slot_count(std::size_t option_count)
+{
+    std::size_t size = 1;
+    while (size < 2 * option_count + 1)
+    {
+        size <<= 1;
+    }
+    return size;
+}
+
+// The C type of the parameter stored in a member, checked against an explicit type
+template <typename Value>
+constexpr dash_Type type_of()
+{
+    if constexpr (std::is_same_v<Value, char*>)
+    {
+        return DASH_TYPE_STRING;
+    }
+    else if constexpr (std::is_same_v<Value, int64_t>)
+    {
+        return DASH_TYPE_INT64;
+    }
+    else if constexpr (std::is_same_v<Value, uint64_t>)
+    {
+        return DASH_TYPE_UINT64;
+    }
+    else if constexpr (std::is_same_v<Value, double>)
+    {
+        return DASH_TYPE_DOUBLE;
+    }
+    else if constexpr (std::is_same_v<Value, dash_List>)
+    {
+        return DASH_TYPE_LIST;
+    }
+    else
+    {
+        static_assert(!std::is_same_v<Value, Value>, "A parameter is stored in a char*, int64_t, uint64_t, double or dash_List member");
+        return DASH_TYPE_STRING;
+    }
+}
+
+template <auto Member>
+void* address_of(Struct_Of<Member>& values)
+{
+    return &(values.*Member);
+}
+
+template <auto Member>
+bool* unset_address_of(Struct_Of<Member>& values)
+{
+    return &(values.*Member);
+}
+
+}
+
+// One entry of a table, the pointers of its dash_Longopt are only filled for the structure being parsed
+template <typename Struct>
+struct Option
+{
+    dash_Longopt longopt;
+    void* (*value)(Struct& values);
+    bool* (*unset)(Struct& values);
+
+    constexpr Option describe(const char* description) const
+    {
+        Option option = *this;
+        option.longopt.description = description;
+        return option;
+    }
+
+    // Allow +X, which turns a flag off or reports the polarity of a parameter through unset_into
+    constexpr Option unsettable() const
+    {
+        Option option = *this;
+        option.longopt.allow_flag_unset = true;
+        return option;
+    }
+
+    constexpr Option optional() const
+    {
+        Option option = *this;
+        if (option.longopt.param_name == nullptr)
+        {
+            detail::optional_parameter_without_parameter();
+        }
+        option.longopt.param_optional = true;
+        return option;
+    }
+
+    constexpr Option env(const char* name) const
+    {
+        Option option = *this;
+        option.longopt.env_name = name;
+        return option;
+    }
+
+    template <auto Member>
+    constexpr Option unset_into() const
+    {
+        static_assert(std::is_same_v<detail::Struct_Of<Member>, Struct>, "The member belongs to another structure");
+        static_assert(std::is_same_v<detail::Value_Of<Member>, bool>, "The polarity is stored in a bool member");
+        Option option = *this;
+        option.unset = &detail::unset_address_of<Member>;
+        return option;
+    }
+};
+
+template <typename Struct>
+constexpr Option<Struct> make_option(char short_name, const char* long_name, const char* param_name, dash_Type type, void* (*value)(Struct&))
+{
+    Option<Struct> option = {dash_Longopt(), value, nullptr};
+    option.longopt.opt_name = short_name;
+    option.longopt.longopt_name = long_name;
+    option.longopt.param_name = param_name;
+    option.longopt.type = type;
+    return option;
+}
+
+// An option without a parameter, stored in a bool member
+template <auto Member>
+constexpr Option<detail::Struct_Of<Member>> flag(char short_name, const char* long_name = nullptr)
+{
+    static_assert(std::is_same_v<detail::Value_Of<Member>, bool>, "A flag is stored in a bool member");
+    return make_option<detail::Struct_Of<Member>>(short_name, long_name, nullptr, DASH_TYPE_STRING, &detail::address_of<Member>);
+}
+
+// An option without a parameter counting its occurrences in an int member
+template <auto Member>
+constexpr Option<detail::Struct_Of<Member>> count(char short_name, const char* long_name = nullptr)
+{
+    static_assert(std::is_same_v<detail::Value_Of<Member>, int>, "A counter is stored in an int member");
+    return make_option<detail::Struct_Of<Member>>(short_name, long_name, nullptr, DASH_TYPE_COUNT, &detail::address_of<Member>);
+}
+
+// An option with a parameter, its type comes from the member unless it is a size or a duration in a uint64_t
+template <auto Member>
+constexpr Option<detail::Struct_Of<Member>> param(char short_name, const char* long_name, const char* param_name, dash_Type type = detail::type_of<detail::Value_Of<Member>>())
+{
+    constexpr dash_Type member_type = detail::type_of<detail::Value_Of<Member>>();
+    if (type != member_type && !(member_type == DASH_TYPE_UINT64 && (type == DASH_TYPE_SIZE || type == DASH_TYPE_DURATION)))
+    {
+        detail::type_does_not_match_member();
+    }
+    return make_option<detail::Struct_Of<Member>>(short_name, long_name, param_name, type, &detail::address_of<Member>);
+}
+
+template <typename Struct, std::size_t N>
+class Table
+{
+public:
+    static constexpr std::size_t slots = detail::slot_count(N);
+
+    // Names are checked and the short table and long hash table of a dash_Index are filled at compile time
+    constexpr explicit Table(const std::array<Option<Struct>, N>& options)
+        : options_(options), short_options_(), long_options_(), long_hashes_(), long_count_(0)
+    {
+        std::size_t slot = 0;
+        unsigned hash = 0;
+
+        for (std::size_t i = 0; i < 256; i++)
+        {
+            short_options_[i] = -1;
+        }
+        for (std::size_t i = 0; i < slots; i++)
+        {
+            long_options_[i] = -1;
+            long_hashes_[i] = 0;
+        }
+        for (std::size_t i = 0; i < N; i++)
+        {
+            const dash_Longopt& option = options_[i].longopt;
+
+            // It would end the table given to the C functions
+            if (option.opt_name == '\0' && option.longopt_name == nullptr)
+            {
+                detail::option_without_name();
+            }
+            if (option.opt_name != '\0')
+            {
+                if (short_options_[(unsigned char) option.opt_name] != -1)
+                {
+                    detail::duplicate_short_name();
+                }
+                short_options_[(unsigned char) option.opt_name] = (int) i;
+            }
+            if (option.longopt_name == nullptr)
+            {
+                continue;
+            }
+            if (detail::has_equal(option.longopt_name))
+            {
+                detail::long_name_with_equal();
+            }
+            hash = detail::hash_name(option.longopt_name);
+            for (slot = hash & (slots - 1); long_options_[slot] != -1; slot = (slot + 1) & (slots - 1))
+            {
+                if (long_hashes_[slot] == hash && detail::same_name(options_[long_options_[slot]].longopt.longopt_name, option.longopt_name))
+                {
+                    detail::duplicate_long_name();
+                }
+            }
+            long_options_[slot] = (int) i;
+            long_hashes_[slot] = hash;
+            long_count_++;
+        }
+    }
+
+    // The C table for a structure, terminated like any other, for dash_print_usage or dash_print_summary
+    std::array<dash_Longopt, N + 1> longopts(Struct& values) const
+    {
+        std::array<dash_Longopt, N + 1> table = {};
+
+        for (std::size_t i = 0; i < N; i++)
+        {
+            table[i] = options_[i].longopt;
+            table[i].user_pointer = options_[i].value(values);
+            table[i].unset_pointer = options_[i].unset != nullptr ? options_[i].unset(values) : nullptr;
+        }
+        return table;
+    }
+
+    // Same as dash_arg_parser_ex, the index of the settings is replaced by the one of the table
+    bool parse(int* argc, char* argv[], Struct& values, dash_Settings settings = {}) const
+    {
+        std::array<dash_Longopt, N + 1> table = longopts(values);
+        dash_Index index;
+        bool ok;
+
+        // Abbreviations need the radix tree of prefixes, which is only built at run time
+        if (settings.flags & DASH_ABBREVIATIONS)
+        {
+            if (!dash_compile_options(&index, table.data()))
+            {
+                return false;
+            }
+            settings.index = &index;
+            ok = dash_arg_parser_ex(argc, argv, table.data(), &settings);
+            dash_free_index(&index);
+            return ok;
+        }
+
+        // The C lookups never write through the index
+        index.options = table.data();
+        index.structure_length = (int) N;
+        for (std::size_t i = 0; i < 256; i++)
+        {
+            index.short_options[i] = short_options_[i];
+        }
+        index.long_options = const_cast<int*>(long_options_.data());
+        index.long_hashes = const_cast<unsigned*>(long_hashes_.data());
+        index.long_mask = slots - 1;
+        index.long_sorted = nullptr;
+        index.long_count = long_count_;
+        index.prefix_nodes = nullptr;
+        index.prefix_labels = nullptr;
+        index.long_signatures = nullptr;
+        index.hot = nullptr;
+        index.table_hash = 0;
+        settings.index = &index;
+        return dash_arg_parser_ex(argc, argv, table.data(), &settings);
+    }
+
+    // Same as dash_free_ex, with the settings given to parse
+    void free(Struct& values, const dash_Settings& settings = {}) const
+    {
+        std::array<dash_Longopt, N + 1> table = longopts(values);
+
+        dash_free_ex(table.data(), &settings);
+    }
+
+    constexpr const Option<Struct>& operator[](std::size_t i) const
+    {
+        return options_[i];
+    }
+
+    constexpr std::size_t size() const
+    {
+        return N;
+    }
+
+private:
+    std::array<Option<Struct>, N> options_;
+    std::array<int, 256> short_options_;
+    std::array<int, slots> long_options_;
+    std::array<unsigned, slots> long_hashes_;
+    int long_count_;
+};
+
+// Every option has to write into the same structure
+template <typename Struct, typename... Options>
+constexpr Table<Struct, 1 + sizeof...(Options)> make_table(const Option<Struct>& first, const Options&... rest)
+{
+    static_assert((std::is_same_v<Options, Option<Struct>> && ...), "Every option of a table writes into the same structure");
+    return Table<Struct, 1 + sizeof...(Options)>(std::array<Option<Struct>, 1 + sizeof...(Options)>{{first, rest...}});
+}
+
+}
+
+#endif
@@ -0,0 +1,976 @@
+/*
+Copyright 2024 Valentin Foulon
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the “Software”), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+// Turns an option specification into a C parser specialized to that table.
+//
+// Usage: dashgen SPECIFICATION OUTPUT.c OUTPUT.h
+//
+// The specification holds one directive per line, '#' starts a comment:
+//   prefix example
+//   option short=c long=command param=line field=command_string description="Execute $ as a command"
+//   option short=o unset optional param=option field=print_options unset_field=print_options_unset
+//
+// The generated parser behaves like dash_arg_parser on the equivalent dash_Longopt table.
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <ctype.h>
+
+#define MAX_LINE_LENGTH 4096
+
+typedef struct {
+    char opt_name;
+    bool allow_flag_unset;
+    bool param_optional;
+    char* param_name;
+    char* longopt_name;
+    char* description;
+    char* field;
+    char* unset_field;
+} Option;
+
+typedef struct {
+    char* prefix;
+    Option* options;
+    int option_count;
+    int option_capacity;
+} Specification;
+
+static void fatal(const char* path, int line, const char* message, const char* detail)
+{
+    fprintf(stderr, "%s:%d: %s", path, line, message);
+    if (detail != NULL)
+    {
+        fprintf(stderr, " '%s'", detail);
+    }
+    fputc('\n', stderr);
+    exit(1);
+}
+
+static char* duplicate(const char* str, size_t length)
+{
+    char* copy = malloc(length + 1);
+    if (copy == NULL)
+    {
+        fputs("Out of memory\n", stderr);
+        exit(1);
+    }
+    memcpy(copy, str, length);
+    copy[length] = '\0';
+    return copy;
+}
+
+static bool is_identifier(const char* str)
+{
+    if (!isalpha((unsigned char) str[0]) && str[0] != '_')
+    {
+        return false;
+    }
+    for (int i = 1; str[i] != '\0'; i++)
+    {
+        if (!isalnum((unsigned char) str[i]) && str[i] != '_')
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Read the next 'key', 'key=value' or 'key="quoted value"' word, return false at the end of the line
+static bool next_word(char** cursor, char** key, char** value, const char* path, int line)
+{
+    char* start;
+    char* write;
+
+    while (**cursor == ' ' || **cursor == '\t')
+    {
+        (*cursor)++;
+    }
+    if (**cursor == '\0' || **cursor == '#' || **cursor == '\n' || **cursor == '\r')
+    {
+        return false;
+    }
+
+    start = *cursor;
+    while (**cursor != '\0' && **cursor != '=' && **cursor != ' ' && **cursor != '\t' && **cursor != '\n' && **cursor != '\r')
+    {
+        (*cursor)++;
+    }
+    *key = duplicate(start, *cursor - start);
+    *value = NULL;
+    if (**cursor != '=')
+    {
+        return true;
+    }
+
+    (*cursor)++;
+    if (**cursor != '"')
+    {
+        start = *cursor;
+        while (**cursor != '\0' && **cursor != ' ' && **cursor != '\t' && **cursor != '\n' && **cursor != '\r')
+        {
+            (*cursor)++;
+        }
+        *value = duplicate(start, *cursor - start);
+        return true;
+    }
+
+    // Quoted value, unescape in place
+    (*cursor)++;
+    start = write = *cursor;
+    while (**cursor != '"')
+    {
+        if (**cursor == '\0' || **cursor == '\n')
+        {
+            fatal(path, line, "Unterminated quoted value for", *key);
+        }
+        if (**cursor == '\\' && (*cursor)[1] != '\0')
+        {
+            (*cursor)++;
+        }
+        *write++ = **cursor;
+        (*cursor)++;
+    }
+    (*cursor)++;
+    *value = duplicate(start, write - start);
+    return true;
+}
+
+static void parse_option(Specification* specification, char* cursor, const char* path, int line)
+{
+    Option* option;
+    char* key;
+    char* value;
+
+    if (specification->option_count == specification->option_capacity)
+    {
+        specification->option_capacity = specification->option_capacity == 0 ? 16 : specification->option_capacity * 2;
+        specification->options = realloc(specification->options, specification->option_capacity * sizeof(Option));
+        if (specification->options == NULL)
+        {
+            fputs("Out of memory\n", stderr);
+            exit(1);
+        }
+    }
+    option = &specification->options[specification->option_count];
+    memset(option, 0, sizeof(Option));
+
+    while (next_word(&cursor, &key, &value, path, line))
+    {
+        if (!strcmp(key, "unset") || !strcmp(key, "optional"))
+        {
+            if (value != NULL)
+            {
+                fatal(path, line, "Flag takes no value", key);
+            }
+            if (key[0] == 'u')
+            {
+                option->allow_flag_unset = true;
+            }
+            else
+            {
+                option->param_optional = true;
+            }
+            free(key);
+            continue;
+        }
+        if (value == NULL)
+        {
+            fatal(path, line, "Missing value for", key);
+        }
+        if (!strcmp(key, "short"))
+        {
+            if (strlen(value) != 1 || value[0] == '-' || value[0] == '+')
+            {
+                fatal(path, line, "Short name must be a single character", value);
+            }
+            option->opt_name = value[0];
+            free(value);
+        }
+        else if (!strcmp(key, "long"))
+        {
+            if (value[0] == '\0' || strchr(value, '=') != NULL)
+            {
+                fatal(path, line, "Invalid long name", value);
+            }
+            option->longopt_name = value;
+        }
+        else if (!strcmp(key, "param"))
+        {
+            option->param_name = value;
+        }
+        else if (!strcmp(key, "description"))
+        {
+            option->description = value;
+        }
+        else if (!strcmp(key, "field") || !strcmp(key, "unset_field"))
+        {
+            if (!is_identifier(value))
+            {
+                fatal(path, line, "Field is not a C identifier", value);
+            }
+            if (key[0] == 'f')
+            {
+                option->field = value;
+            }
+            else
+            {
+                option->unset_field = value;
+            }
+        }
+        else
+        {
+            fatal(path, line, "Unknown key", key);
+        }
+        free(key);
+    }
+
+    if (option->opt_name == '\0' && option->longopt_name == NULL)
+    {
+        fatal(path, line, "Option has neither a short nor a long name", NULL);
+    }
+    if (option->field == NULL)
+    {
+        fatal(path, line, "Option has no field", NULL);
+    }
+    if (option->unset_field != NULL && option->param_name == NULL)
+    {
+        fatal(path, line, "unset_field requires a parameter", option->unset_field);
+    }
+
+    // Same checks as dash_compile_options
+    for (int i = 0; i < specification->option_count; i++)
+    {
+        const Option* other = &specification->options[i];
+        if (option->opt_name != '\0' && other->opt_name == option->opt_name)
+        {
+            fatal(path, line, "Duplicate short name", NULL);
+        }
+        if (option->longopt_name != NULL && other->longopt_name != NULL && !strcmp(other->longopt_name, option->longopt_name))
+        {
+            fatal(path, line, "Duplicate long name", option->longopt_name);
+        }
+        if (!strcmp(other->field, option->field) && (other->param_name == NULL) != (option->param_name == NULL))
+        {
+            fatal(path, line, "Field is used both as a bool and as a string", option->field);
+        }
+    }
+    specification->option_count++;
+}
+
+static void read_specification(Specification* specification, const char* path)
+{
+    char buffer[MAX_LINE_LENGTH];
+    FILE* file = fopen(path, "r");
+    int line = 0;
+    char* cursor;
+    char* key;
+    char* value;
+
+    if (file == NULL)
+    {
+        perror(path);
+        exit(1);
+    }
+
+    while (fgets(buffer, sizeof(buffer), file) != NULL)
+    {
+        line++;
+        cursor = buffer;
+        if (!next_word(&cursor, &key, &value, path, line))
+        {
+            continue;
+        }
+        if (!strcmp(key, "prefix"))
+        {
+            free(key);
+            if (!next_word(&cursor, &key, &value, path, line) || value != NULL || !is_identifier(key))
+            {
+                fatal(path, line, "prefix expects a C identifier", NULL);
+            }
+            specification->prefix = key;
+        }
+        else if (!strcmp(key, "option"))
+        {
+            free(key);
+            parse_option(specification, cursor, path, line);
+        }
+        else
+        {
+            fatal(path, line, "Unknown directive", key);
+        }
+    }
+    fclose(file);
+
+    if (specification->prefix == NULL)
+    {
+        fatal(path, line, "Missing prefix directive", NULL);
+    }
+}
+
+// Write text, replacing every '@' with the prefix
+static void emit(FILE* output, const Specification* specification, const char* text)
+{
+    for (; *text != '\0'; text++)
+    {
+        if (*text == '@')
+        {
+            fputs(specification->prefix, output);
+        }
+        else
+        {
+            fputc(*text, output);
+        }
+    }
+}
+
+static void emit_string(FILE* output, const char* str)
+{
+    if (str == NULL)
+    {
+        fputs("NULL", output);
+        return;
+    }
+    fputc('"', output);
+    for (; *str != '\0'; str++)
+    {
+        if (*str == '"' || *str == '\\')
+        {
+            fprintf(output, "\\%c", *str);
+        }
+        else if (isprint((unsigned char) *str))
+        {
+            fputc(*str, output);
+        }
+        else
+        {
+            fprintf(output, "\\%03o", (unsigned char) *str);
+        }
+    }
+    fputc('"', output);
+}
+
+static void emit_char(FILE* output, char c)
+{
+    if (c == '\'' || c == '\\')
+    {
+        fprintf(output, "'\\%c'", c);
+    }
+    else if (isprint((unsigned char) c))
+    {
+        fprintf(output, "'%c'", c);
+    }
+    else
+    {
+        fprintf(output, "'\\%03o'", (unsigned char) c);
+    }
+}
+
+static void indent(FILE* output, int depth)
+{
+    for (int i = 0; i < depth; i++)
+    {
+        fputs("    ", output);
+    }
+}
+
+// Emit a decision tree over long names of the same length, switching on the most discriminating character
+static void emit_long_tree(FILE* output, const Specification* specification, int* candidates, int count, size_t length, int depth)
+{
+    size_t best_position = 0;
+    int best_distinct = 0;
+    int* group;
+    int group_count;
+    bool seen[256];
+
+    if (count == 1)
+    {
+        indent(output, depth);
+        fprintf(output, "return memcmp(name, ");
+        emit_string(output, specification->options[candidates[0]].longopt_name);
+        fprintf(output, ", %zu) ? -1 : %d;\n", length, candidates[0]);
+        return;
+    }
+
+    for (size_t position = 0; position < length; position++)
+    {
+        int distinct = 0;
+        memset(seen, 0, sizeof(seen));
+        for (int i = 0; i < count; i++)
+        {
+            unsigned char c = specification->options[candidates[i]].longopt_name[position];
+            if (!seen[c])
+            {
+                seen[c] = true;
+                distinct++;
+            }
+        }
+        if (distinct > best_distinct)
+        {
+            best_distinct = distinct;
+            best_position = position;
+        }
+    }
+
+    group = malloc(count * sizeof(int));
+    if (group == NULL)
+    {
+        fputs("Out of memory\n", stderr);
+        exit(1);
+    }
+
+    indent(output, depth);
+    fprintf(output, "switch (name[%zu])\n", best_position);
+    indent(output, depth);
+    fputs("{\n", output);
+    memset(seen, 0, sizeof(seen));
+    for (int i = 0; i < count; i++)
+    {
+        unsigned char c = specification->options[candidates[i]].longopt_name[best_position];
+        if (seen[c])
+        {
+            continue;
+        }
+        seen[c] = true;
+        group_count = 0;
+        for (int j = i; j < count; j++)
+        {
+            if ((unsigned char) specification->options[candidates[j]].longopt_name[best_position] == c)
+            {
+                group[group_count++] = candidates[j];
+            }
+        }
+        indent(output, depth + 1);
+        fputs("case ", output);
+        emit_char(output, (char) c);
+        fputs(":\n", output);
+        indent(output, depth + 1);
+        fputs("{\n", output);
+        emit_long_tree(output, specification, group, group_count, length, depth + 2);
+        indent(output, depth + 1);
+        fputs("}\n", output);
+    }
+    indent(output, depth);
+    fputs("}\n", output);
+    indent(output, depth);
+    fputs("return -1;\n", output);
+    free(group);
+}
+
+static void emit_header(FILE* output, const Specification* specification, const char* path)
+{
+    const char* fields_seen[specification->option_count * 2 + 1];
+    int field_count = 0;
+
+    fprintf(output, "// Generated by dashgen from %s, do not edit\n\n", path);
+    emit(output, specification, "#ifndef @_OPTIONS_H\n#define @_OPTIONS_H\n\n#include <stdbool.h>\n\n#include \"dash.h\"\n\n");
+    emit(output, specification, "typedef struct {\n");
+    for (int i = 0; i < specification->option_count; i++)
+    {
+        const Option* option = &specification->options[i];
+        const char* fields[2] = {option->field, option->unset_field};
+        for (int k = 0; k < 2; k++)
+        {
+            bool already = false;
+            if (fields[k] == NULL)
+            {
+                continue;
+            }
+            for (int j = 0; j < field_count; j++)
+            {
+                if (!strcmp(fields_seen[j], fields[k]))
+                {
+                    already = true;
+                }
+            }
+            if (already)
+            {
+                continue;
+            }
+            fields_seen[field_count++] = fields[k];
+            fprintf(output, "    %s %s;\n", (k == 0 && option->param_name != NULL) ? "char*" : "bool", fields[k]);
+        }
+    }
+    emit(output, specification, "} @_Arguments;\n\n");
+    fprintf(output, "#define %s_OPTION_COUNT %d\n\n", specification->prefix, specification->option_count);
+    emit(output, specification,
+        "bool @_arg_parser(int* argc, char* argv[], @_Arguments* arguments);\n"
+        "void @_free(@_Arguments* arguments);\n"
+        "void @_options(@_Arguments* arguments, dash_Longopt options[@_OPTION_COUNT + 1]);\n\n"
+        "#endif\n");
+}
+
+static const char* parse_loop =
+"bool @_arg_parser(int* argc, char* argv[], @_Arguments* arguments)\n"
+"{\n"
+"    int argument_non_option_index = 1;\n"
+"    int argument_non_option_count = 1;\n"
+"\n"
+"    int found_structure_index = -1;\n"
+"    bool last_opt_was_unset = false;\n"
+"    bool long_opt_was_provided_with_equal = false;\n"
+"\n"
+"    bool option_should_have_argument;\n"
+"\n"
+"    int c;\n"
+"\n"
+"    @_reset(arguments);\n"
+"\n"
+"    for (int i = 1; i < *argc; i++)\n"
+"    {\n"
+"        // Previous flag did not specify argument\n"
+"        if (found_structure_index != -1 && !long_opt_was_provided_with_equal)\n"
+"        {\n"
+"            // We need an argument\n"
+"            if ((@_flags[found_structure_index] & (FLAG_PARAM | FLAG_OPTIONAL)) == FLAG_PARAM)\n"
+"            {\n"
+"                if (argv[i][0] == '-')\n"
+"                {\n"
+"                    return false;\n"
+"                }\n"
+"                if (!@_store(arguments, found_structure_index, argv[i], last_opt_was_unset))\n"
+"                {\n"
+"                    return false;\n"
+"                }\n"
+"                argv[i] = NULL;\n"
+"                found_structure_index = -1;\n"
+"                continue;\n"
+"            }\n"
+"            // Try to search for an argument\n"
+"            else if (@_flags[found_structure_index] & FLAG_PARAM)\n"
+"            {\n"
+"                if (argv[i][0] != '-')\n"
+"                {\n"
+"                    if (!@_store(arguments, found_structure_index, argv[i], last_opt_was_unset))\n"
+"                    {\n"
+"                        return false;\n"
+"                    }\n"
+"                    argv[i] = NULL;\n"
+"                    found_structure_index = -1;\n"
+"                    continue;\n"
+"                }\n"
+"                else if (!@_store(arguments, found_structure_index, \"\", last_opt_was_unset))\n"
+"                {\n"
+"                    return false;\n"
+"                }\n"
+"            }\n"
+"        }\n"
+"\n"
+"        long_opt_was_provided_with_equal = false;\n"
+"        found_structure_index = -1;\n"
+"\n"
+"        // Check if argument begins with a dash or a plus\n"
+"        if (argv[i][0] != '-' && argv[i][0] != '+')\n"
+"        {\n"
+"            argument_non_option_count += 1;\n"
+"            continue;\n"
+"        }\n"
+"\n"
+"        // If argument begins with a plus, unset shortopt\n"
+"        if (argv[i][0] == '+')\n"
+"        {\n"
+"            last_opt_was_unset = true;\n"
+"            c = 1;\n"
+"            option_should_have_argument = false;\n"
+"            while (argv[i][c] != '\\0')\n"
+"            {\n"
+"                if (option_should_have_argument == true)\n"
+"                {\n"
+"                    if (!@_store(arguments, found_structure_index, &argv[i][c], true))\n"
+"                    {\n"
+"                        return false;\n"
+"                    }\n"
+"                    found_structure_index = -1;\n"
+"                    break;\n"
+"                }\n"
+"                if ((found_structure_index = @_shortopt(arguments, argv[i][c], true)) == -1)\n"
+"                {\n"
+"                    return false;\n"
+"                }\n"
+"                option_should_have_argument = (@_flags[found_structure_index] & (FLAG_PARAM | FLAG_OPTIONAL)) == (FLAG_PARAM | FLAG_OPTIONAL);\n"
+"                c++;\n"
+"            }\n"
+"            argv[i] = NULL;\n"
+"            continue;\n"
+"        }\n"
+"\n"
+"        last_opt_was_unset = false;\n"
+"\n"
+"        // Double dash, long opt\n"
+"        if (argv[i][1] == '-')\n"
+"        {\n"
+"            // Only double dash, end of parsing arguments\n"
+"            if (argv[i][2] == '\\0')\n"
+"            {\n"
+"                argument_non_option_count += *argc - i - 1;\n"
+"                argv[i] = NULL;\n"
+"                goto REORGANIZE;\n"
+"            }\n"
+"            if ((found_structure_index = @_longopt(arguments, &argv[i][2], &long_opt_was_provided_with_equal)) == -1)\n"
+"            {\n"
+"                return false;\n"
+"            }\n"
+"            argv[i] = NULL;\n"
+"        }\n"
+"        // Single dash, ignore (will be used as stdin)\n"
+"        else if (argv[i][1] == '\\0')\n"
+"        {\n"
+"            argument_non_option_count += 1;\n"
+"            continue;\n"
+"        }\n"
+"        // Short opt\n"
+"        else\n"
+"        {\n"
+"            c = 1;\n"
+"            option_should_have_argument = false;\n"
+"            while (argv[i][c] != '\\0')\n"
+"            {\n"
+"                if (option_should_have_argument == true)\n"
+"                {\n"
+"                    if (!@_store(arguments, found_structure_index, &argv[i][c], false))\n"
+"                    {\n"
+"                        return false;\n"
+"                    }\n"
+"                    found_structure_index = -1;\n"
+"                    break;\n"
+"                }\n"
+"                if ((found_structure_index = @_shortopt(arguments, argv[i][c], false)) == -1)\n"
+"                {\n"
+"                    return false;\n"
+"                }\n"
+"                option_should_have_argument = (@_flags[found_structure_index] & (FLAG_PARAM | FLAG_OPTIONAL)) == FLAG_PARAM;\n"
+"                c++;\n"
+"            }\n"
+"            argv[i] = NULL;\n"
+"        }\n"
+"    }\n"
+"\n"
+"REORGANIZE:\n"
+"\n"
+"    if (found_structure_index != -1 && (@_flags[found_structure_index] & (FLAG_PARAM | FLAG_OPTIONAL)) == (FLAG_PARAM | FLAG_OPTIONAL) && !long_opt_was_provided_with_equal)\n"
+"    {\n"
+"        if (!@_store(arguments, found_structure_index, \"\", last_opt_was_unset))\n"
+"        {\n"
+"            return false;\n"
+"        }\n"
+"    }\n"
+"\n"
+"    if (found_structure_index != -1 && (@_flags[found_structure_index] & (FLAG_PARAM | FLAG_OPTIONAL)) == FLAG_PARAM && !long_opt_was_provided_with_equal)\n"
+"    {\n"
+"        return false;\n"
+"    }\n"
+"\n"
+"    for (int i = 1; i < *argc; i++)\n"
+"    {\n"
+"        if (argv[i] != NULL)\n"
+"        {\n"
+"            argv[argument_non_option_index] = argv[i];\n"
+"            if (i != argument_non_option_index++)\n"
+"            {\n"
+"                argv[i] = NULL;\n"
+"            }\n"
+"        }\n"
+"    }\n"
+"\n"
+"    *argc = argument_non_option_count;\n"
+"\n"
+"    return true;\n"
+"}\n";
+
+static void emit_source(FILE* output, const Specification* specification, const char* path, const char* header_path)
+{
+    const char* header_name = strrchr(header_path, '/');
+    int* candidates;
+    size_t max_length = 0;
+
+    header_name = header_name == NULL ? header_path : header_name + 1;
+
+    fprintf(output, "// Generated by dashgen from %s, do not edit\n\n", path);
+    fputs("#include <stdlib.h>\n#include <string.h>\n\n", output);
+    fprintf(output, "#include \"%s\"\n\n", header_name);
+    fputs("enum OPTION_FLAGS {\n    FLAG_PARAM = 1 << 0,\n    FLAG_OPTIONAL = 1 << 1,\n    FLAG_UNSET = 1 << 2\n};\n\n", output);
+
+    // Per-option flags
+    emit(output, specification, "static const unsigned char @_flags[@_OPTION_COUNT] = {\n");
+    for (int i = 0; i < specification->option_count; i++)
+    {
+        const Option* option = &specification->options[i];
+        fprintf(output, "    %s%s%s,\n",
+            option->param_name != NULL ? "FLAG_PARAM" : "0",
+            option->param_name != NULL && option->param_optional ? " | FLAG_OPTIONAL" : "",
+            option->allow_flag_unset ? " | FLAG_UNSET" : "");
+    }
+    fputs("};\n\n", output);
+
+    // Reset every field, like the first pass of dash_arg_parser
+    emit(output, specification, "static void @_reset(@_Arguments* arguments)\n{\n");
+    for (int i = 0; i < specification->option_count; i++)
+    {
+        const Option* option = &specification->options[i];
+        fprintf(output, "    arguments->%s = %s;\n", option->field, option->param_name != NULL ? "NULL" : "false");
+        if (option->unset_field != NULL)
+        {
+            fprintf(output, "    arguments->%s = false;\n", option->unset_field);
+        }
+    }
+    fputs("}\n\n", output);
+
+    // String stores
+    emit(output, specification,
+        "static bool @_store(@_Arguments* arguments, int option, const char* value, bool unset)\n"
+        "{\n"
+        "    char** destination;\n"
+        "    bool* unset_destination = NULL;\n"
+        "    size_t value_length;\n"
+        "    int allow_flag_unset = (@_flags[option] & FLAG_UNSET) != 0;\n"
+        "\n"
+        "    switch (option)\n"
+        "    {\n");
+    for (int i = 0; i < specification->option_count; i++)
+    {
+        const Option* option = &specification->options[i];
+        if (option->param_name == NULL)
+        {
+            continue;
+        }
+        fprintf(output, "        case %d:\n            destination = &arguments->%s;\n", i, option->field);
+        if (option->unset_field != NULL)
+        {
+            fprintf(output, "            unset_destination = &arguments->%s;\n", option->unset_field);
+        }
+        fputs("            break;\n", output);
+    }
+    emit(output, specification,
+        "        default:\n"
+        "            return false;\n"
+        "    }\n"
+        "\n"
+        "    // A non-boolean flag can only be set once\n"
+        "    if (*destination != NULL)\n"
+        "    {\n"
+        "        return false;\n"
+        "    }\n"
+        "    if (unset_destination != NULL)\n"
+        "    {\n"
+        "        *unset_destination = unset;\n"
+        "    }\n"
+        "    value_length = strlen(value);\n"
+        "    *destination = malloc((value_length + allow_flag_unset + 1) * sizeof(char));\n"
+        "    if (*destination == NULL)\n"
+        "    {\n"
+        "        return false;\n"
+        "    }\n"
+        "    if (allow_flag_unset)\n"
+        "    {\n"
+        "        (*destination)[0] = unset ? '+' : '-';\n"
+        "    }\n"
+        "    memcpy(&(*destination)[allow_flag_unset], value, value_length + 1);\n"
+        "    return true;\n"
+        "}\n\n");
+
+    // Short options
+    emit(output, specification, "static int @_shortopt(@_Arguments* arguments, char name, bool unset)\n{\n    switch (name)\n    {\n");
+    for (int i = 0; i < specification->option_count; i++)
+    {
+        const Option* option = &specification->options[i];
+        if (option->opt_name == '\0')
+        {
+            continue;
+        }
+        fputs("        case ", output);
+        emit_char(output, option->opt_name);
+        fputs(":\n", output);
+        if (!option->allow_flag_unset)
+        {
+            fputs("            if (unset)\n            {\n                return -1;\n            }\n", output);
+        }
+        if (option->param_name == NULL)
+        {
+            fprintf(output, "            arguments->%s = !unset;\n", option->field);
+        }
+        fprintf(output, "            return %d;\n", i);
+    }
+    fputs("        default:\n            return -1;\n    }\n    (void) arguments;\n}\n\n", output);
+
+    // Long names, one decision tree per length
+    for (int i = 0; i < specification->option_count; i++)
+    {
+        if (specification->options[i].longopt_name != NULL && strlen(specification->options[i].longopt_name) > max_length)
+        {
+            max_length = strlen(specification->options[i].longopt_name);
+        }
+    }
+    candidates = malloc((specification->option_count + 1) * sizeof(int));
+    if (candidates == NULL)
+    {
+        fputs("Out of memory\n", stderr);
+        exit(1);
+    }
+    emit(output, specification, "static int @_find_longopt(const char* name, size_t length)\n{\n    switch (length)\n    {\n");
+    for (size_t length = 1; length <= max_length; length++)
+    {
+        int count = 0;
+        for (int i = 0; i < specification->option_count; i++)
+        {
+            if (specification->options[i].longopt_name != NULL && strlen(specification->options[i].longopt_name) == length)
+            {
+                candidates[count++] = i;
+            }
+        }
+        if (count == 0)
+        {
+            continue;
+        }
+        fprintf(output, "        case %zu:\n        {\n", length);
+        emit_long_tree(output, specification, candidates, count, length, 3);
+        fputs("        }\n", output);
+    }
+    fputs("        default:\n            return -1;\n    }\n}\n\n", output);
+    free(candidates);
+
+    emit(output, specification,
+        "static int @_longopt(@_Arguments* arguments, char* name, bool* arg_provided_with_equal)\n"
+        "{\n"
+        "    size_t length = 0;\n"
+        "    int found;\n"
+        "\n"
+        "    while (name[length] != '\\0' && name[length] != '=')\n"
+        "    {\n"
+        "        length++;\n"
+        "    }\n"
+        "    *arg_provided_with_equal = name[length] == '=';\n"
+        "    if ((found = @_find_longopt(name, length)) == -1)\n"
+        "    {\n"
+        "        return -1;\n"
+        "    }\n"
+        "    if (!(@_flags[found] & FLAG_PARAM))\n"
+        "    {\n"
+        "        if (*arg_provided_with_equal)\n"
+        "        {\n"
+        "            return -1;\n"
+        "        }\n"
+        "        switch (found)\n"
+        "        {\n");
+    for (int i = 0; i < specification->option_count; i++)
+    {
+        const Option* option = &specification->options[i];
+        if (option->longopt_name != NULL && option->param_name == NULL)
+        {
+            fprintf(output, "            case %d:\n                arguments->%s = true;\n                break;\n", i, option->field);
+        }
+    }
+    emit(output, specification,
+        "            default:\n"
+        "                break;\n"
+        "        }\n"
+        "        return found;\n"
+        "    }\n"
+        "    if (*arg_provided_with_equal)\n"
+        "    {\n"
+        "        if (name[length + 1] == '\\0' || !@_store(arguments, found, &name[length + 1], false))\n"
+        "        {\n"
+        "            return -1;\n"
+        "        }\n"
+        "    }\n"
+        "    return found;\n"
+        "}\n\n");
+
+    emit(output, specification, parse_loop);
+
+    emit(output, specification, "\nvoid @_free(@_Arguments* arguments)\n{\n");
+    for (int i = 0; i < specification->option_count; i++)
+    {
+        const Option* option = &specification->options[i];
+        bool first = true;
+        if (option->param_name == NULL)
+        {
+            continue;
+        }
+        // Fields shared by several options are released once
+        for (int j = 0; j < i; j++)
+        {
+            if (!strcmp(specification->options[j].field, option->field))
+            {
+                first = false;
+            }
+        }
+        if (first)
+        {
+            fprintf(output, "    free(arguments->%s);\n    arguments->%s = NULL;\n", option->field, option->field);
+        }
+    }
+    fputs("}\n\n", output);
+
+    // Equivalent dash_Longopt table, for dash_print_usage and friends
+    emit(output, specification, "void @_options(@_Arguments* arguments, dash_Longopt options[@_OPTION_COUNT + 1])\n{\n");
+    for (int i = 0; i < specification->option_count; i++)
+    {
+        const Option* option = &specification->options[i];
+        fprintf(output, "    options[%d] = (dash_Longopt) {.user_pointer = &arguments->%s, .opt_name = ", i, option->field);
+        if (option->opt_name != '\0')
+        {
+            emit_char(output, option->opt_name);
+        }
+        else
+        {
+            fputs("'\\0'", output);
+        }
+        fputs(", .longopt_name = ", output);
+        emit_string(output, option->longopt_name);
+        fputs(", .param_name = ", output);
+        emit_string(output, option->param_name);
+        fputs(", .description = ", output);
+        emit_string(output, option->description);
+        fprintf(output, ", .allow_flag_unset = %s, .param_optional = %s", option->allow_flag_unset ? "true" : "false", option->param_optional ? "true" : "false");
+        if (option->unset_field != NULL)
+        {
+            fprintf(output, ", .unset_pointer = &arguments->%s", option->unset_field);
+        }
+        fputs("};\n", output);
+    }
+    fprintf(output, "    options[%d] = (dash_Longopt) {0};\n}\n", specification->option_count);
+}
+
+int main(int argc, char* argv[])
+{
+    Specification specification = {0};
+    FILE* source;
+    FILE* header;
+
+    if (argc != 4)
+    {
+        fprintf(stderr, "Usage: %s SPECIFICATION OUTPUT.c OUTPUT.h\n", argv[0]);
+        return 1;
+    }
+
+    read_specification(&specification, argv[1]);
+
+    header = fopen(argv[3], "w");
+    if (header == NULL)
+    {
+        perror(argv[3]);
+        return 1;
+    }
+    emit_header(header, &specification, argv[1]);
+    fclose(header);
+
+    source = fopen(argv[2], "w");
+    if (source == NULL)
+    {
+        perror(argv[2]);
+        return 1;
+    }
+    emit_source(source, &specification, argv[1], argv[3]);
+    fclose(source);
+
+    return 0;
+}
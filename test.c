@@ -0,0 +1,1094 @@
+// Tests of the parsers, build and run with `make test`.
+//
+// Random command lines are parsed with and without a compiled index, which must agree on every value, error and
+// remaining argument, then every feature is checked on a few fixed command lines and files.
+
+// setenv is POSIX
+#define _POSIX_C_SOURCE 200809L
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "dash.h"
+#include "test_options.h"
+
+#define OPTION_COUNT 16
+#define MAX_TOKENS 12
+#define ITERATIONS 20000
+
+static int failure_count = 0;
+
+#define CHECK(condition) check(condition, #condition, __LINE__)
+
+static void check(bool ok, const char* text, int line)
+{
+    if (!ok)
+    {
+        fprintf(stderr, "test.c:%d: %s\n", line, text);
+        failure_count++;
+    }
+}
+
+typedef struct {
+    bool verbose;
+    char* verbatim;
+    bool version;
+    int count;
+    char* color;
+    bool color_unset;
+    int64_t jobs;
+    uint64_t job_size;
+    double ratio;
+    dash_List include;
+    char* input;
+    bool in;
+    bool quiet;
+    uint64_t timeout;
+    dash_List tag;
+    bool x;
+    char* output;
+} Values;
+
+// Long names sharing prefixes, so abbreviations are ambiguous or not, and every type of value
+static void build_table(dash_Longopt* options, Values* values)
+{
+    dash_Longopt table[OPTION_COUNT + 1] = {
+        {.opt_name = 'v', .longopt_name = "verbose", .allow_flag_unset = true, .user_pointer = &values->verbose},
+        {.opt_name = 'V', .longopt_name = "verbatim", .param_name = "text", .user_pointer = &values->verbatim},
+        {.longopt_name = "version", .user_pointer = &values->version},
+        {.opt_name = 'c', .longopt_name = "count", .type = DASH_TYPE_COUNT, .allow_flag_unset = true, .user_pointer = &values->count},
+        {.longopt_name = "color", .param_name = "when", .param_optional = true, .allow_flag_unset = true, .user_pointer = &values->color, .unset_pointer = &values->color_unset},
+        {.opt_name = 'j', .longopt_name = "jobs", .param_name = "n", .type = DASH_TYPE_INT64, .user_pointer = &values->jobs},
+        {.longopt_name = "job-size", .param_name = "size", .type = DASH_TYPE_SIZE, .user_pointer = &values->job_size},
+        {.longopt_name = "ratio", .param_name = "r", .type = DASH_TYPE_DOUBLE, .user_pointer = &values->ratio},
+        {.opt_name = 'I', .longopt_name = "include", .param_name = "dir", .type = DASH_TYPE_LIST, .user_pointer = &values->include},
+        {.opt_name = 'i', .longopt_name = "input", .param_name = "file", .user_pointer = &values->input},
+        {.longopt_name = "in", .user_pointer = &values->in},
+        {.opt_name = 'q', .longopt_name = "quiet", .user_pointer = &values->quiet},
+        {.longopt_name = "timeout", .param_name = "duration", .type = DASH_TYPE_DURATION, .user_pointer = &values->timeout},
+        {.longopt_name = "tag", .param_name = "name", .type = DASH_TYPE_LIST, .allow_flag_unset = true, .user_pointer = &values->tag},
+        {.opt_name = 'x', .user_pointer = &values->x},
+        {.opt_name = 'o', .param_name = "file", .user_pointer = &values->output},
+        {0}
+    };
+
+    memset(values, 0, sizeof(*values));
+    memcpy(options, table, sizeof(table));
+}
+
+static size_t format_list(char* buffer, const dash_List* list)
+{
+    size_t length = 0;
+
+    for (int i = 0; i < list->count; i++)
+    {
+        length += sprintf(buffer + length, "%s,", list->values[i]);
+    }
+    return length;
+}
+
+static void format_values(char* buffer, const Values* values)
+{
+    size_t length = sprintf(buffer, "%d %s %d %d %s/%d %" PRId64 " %" PRIu64 " %g %s %d %d %" PRIu64 " %d %s [",
+        values->verbose, values->verbatim ? values->verbatim : "-", values->version, values->count,
+        values->color ? values->color : "-", values->color_unset, values->jobs, values->job_size, values->ratio,
+        values->input ? values->input : "-", values->in, values->quiet, values->timeout, values->x,
+        values->output ? values->output : "-");
+
+    length += format_list(buffer + length, &values->include);
+    length += sprintf(buffer + length, "] [");
+    length += format_list(buffer + length, &values->tag);
+    sprintf(buffer + length, "]");
+}
+
+static const char* const parameters[] = {"1", "2k", "x", "-3", "1.5", "10s", "auto", ""};
+
+// A random token: a long name or a prefix of one, with or without "=value", a short cluster, a +X unset, a
+// parameter, a positional or "--"
+static void random_token(char* token, const dash_Longopt* options)
+{
+    const dash_Longopt* option = &options[rand() % OPTION_COUNT];
+    const char* parameter = parameters[rand() % (sizeof(parameters) / sizeof(parameters[0]))];
+    size_t length;
+
+    switch (rand() % 8)
+    {
+        case 0:
+        case 1:
+        case 2:
+            if (option->longopt_name == NULL)
+            {
+                sprintf(token, "-%c", option->opt_name);
+                return;
+            }
+            length = strlen(option->longopt_name);
+            length = rand() % 2 ? length : 1 + rand() % length;
+            sprintf(token, "%s%.*s", rand() % 6 ? "--" : "+", (int) length, option->longopt_name);
+            if (rand() % 3 == 0)
+            {
+                sprintf(token + strlen(token), "=%s", parameter);
+            }
+            return;
+        case 3:
+            sprintf(token, "-%c%c", "vVcjIiqxo"[rand() % 9], "vcqx1"[rand() % 5]);
+            return;
+        case 4:
+            sprintf(token, "+%c", "vcxq"[rand() % 4]);
+            return;
+        case 5:
+        case 6:
+            strcpy(token, parameter);
+            return;
+        default:
+            strcpy(token, rand() % 4 ? "positional" : "--");
+            return;
+    }
+}
+
+typedef struct {
+    bool ok;
+    dash_Error error;
+    char values[1024];
+    int argc;
+    char argv[MAX_TOKENS][32];
+} Outcome;
+
+static void parse(Outcome* outcome, int argc, char tokens[][32], const dash_Index* index, unsigned flags)
+{
+    dash_Longopt options[OPTION_COUNT + 1];
+    Values values;
+    char* argv[MAX_TOKENS + 1];
+    dash_Settings settings = {.flags = flags, .error = &outcome->error};
+
+    build_table(options, &values);
+    settings.index = index;
+    for (int i = 0; i < argc; i++)
+    {
+        argv[i] = tokens[i];
+    }
+    argv[argc] = NULL;
+    outcome->ok = dash_arg_parser_ex(&argc, argv, options, &settings);
+    format_values(outcome->values, &values);
+    outcome->argc = outcome->ok ? argc : 0;
+    for (int i = 0; i < outcome->argc; i++)
+    {
+        snprintf(outcome->argv[i], sizeof(outcome->argv[i]), "%s", argv[i]);
+    }
+    dash_free_ex(options, &settings);
+}
+
+static bool same_outcome(const Outcome* linear, const Outcome* indexed)
+{
+    if (linear->ok != indexed->ok || strcmp(linear->values, indexed->values) || linear->argc != indexed->argc)
+    {
+        return false;
+    }
+    for (int i = 0; i < linear->argc; i++)
+    {
+        if (strcmp(linear->argv[i], indexed->argv[i]))
+        {
+            return false;
+        }
+    }
+    return linear->ok || (linear->error.code == indexed->error.code && linear->error.option_index == indexed->error.option_index
+        && linear->error.argument_index == indexed->error.argument_index);
+}
+
+// The index is only there to go faster, it must not change a single result
+static void test_index_is_neutral(void)
+{
+    static const unsigned flag_sets[] = {0, DASH_ABBREVIATIONS, DASH_ZERO_COPY, DASH_ABBREVIATIONS | DASH_ZERO_COPY};
+    dash_Longopt options[OPTION_COUNT + 1];
+    Values values;
+    dash_Index index;
+    char tokens[MAX_TOKENS][32];
+    Outcome linear;
+    Outcome indexed;
+    int argc;
+    int mismatches = 0;
+
+    build_table(options, &values);
+    CHECK(dash_compile_options(&index, options));
+    srand(1);
+    for (int iteration = 0; iteration < ITERATIONS; iteration++)
+    {
+        argc = 1 + rand() % (MAX_TOKENS - 1);
+        strcpy(tokens[0], "program");
+        for (int i = 1; i < argc; i++)
+        {
+            random_token(tokens[i], options);
+        }
+        for (size_t f = 0; f < sizeof(flag_sets) / sizeof(flag_sets[0]); f++)
+        {
+            parse(&linear, argc, tokens, NULL, flag_sets[f]);
+            parse(&indexed, argc, tokens, &index, flag_sets[f]);
+            if (!same_outcome(&linear, &indexed) && mismatches++ < 5)
+            {
+                fprintf(stderr, "indexed and linear parses differ, flags %u:", flag_sets[f]);
+                for (int i = 1; i < argc; i++)
+                {
+                    fprintf(stderr, " '%s'", tokens[i]);
+                }
+                fprintf(stderr, "\n  linear  %d %s: %s\n  indexed %d %s: %s\n", linear.ok, dash_error_message(&linear.error), linear.values,
+                    indexed.ok, dash_error_message(&indexed.error), indexed.values);
+            }
+        }
+    }
+    CHECK(mismatches == 0);
+    dash_free_index(&index);
+}
+
+static dash_Error_Code parse_one(const char* token, const dash_Index* index, unsigned flags, dash_Error* error, Values* values)
+{
+    dash_Longopt options[OPTION_COUNT + 1];
+    char* argv[] = {"program", (char*) token, NULL};
+    int argc = 2;
+    dash_Settings settings = {.flags = flags, .error = error};
+
+    build_table(options, values);
+    settings.index = index;
+    dash_arg_parser_ex(&argc, argv, options, &settings);
+    dash_free(options);
+    return error->code;
+}
+
+static void test_abbreviations(void)
+{
+    dash_Longopt options[OPTION_COUNT + 1];
+    Values values;
+    dash_Index index;
+    dash_Error error;
+
+    build_table(options, &values);
+    CHECK(dash_compile_options(&index, options));
+    for (int indexed = 0; indexed < 2; indexed++)
+    {
+        const dash_Index* with = indexed ? &index : NULL;
+
+        // A value given to a flag, by its full name or a prefix
+        CHECK(parse_one("--verbose=x", with, DASH_ABBREVIATIONS, &error, &values) == DASH_ERROR_UNEXPECTED_ARGUMENT);
+        CHECK(parse_one("--verbos=x", with, DASH_ABBREVIATIONS, &error, &values) == DASH_ERROR_UNEXPECTED_ARGUMENT);
+        CHECK(parse_one("--verbos=x", with, 0, &error, &values) == DASH_ERROR_UNKNOWN_OPTION);
+        CHECK(parse_one("--verba=x", with, DASH_ABBREVIATIONS, &error, &values) == DASH_ERROR_NONE);
+        CHECK(parse_one("--tim=5s", with, DASH_ABBREVIATIONS, &error, &values) == DASH_ERROR_NONE);
+
+        // Candidates are only listed with an index, there is never a count without a list
+        CHECK(parse_one("--ver=x", with, DASH_ABBREVIATIONS, &error, &values) == DASH_ERROR_AMBIGUOUS_OPTION);
+        CHECK(error.candidate_count == (indexed ? 3 : 0));
+        CHECK((error.candidates != NULL) == indexed);
+        for (int i = 0; i < error.candidate_count; i++)
+        {
+            CHECK(!strncmp(options[error.candidates[i]].longopt_name, "ver", 3));
+        }
+    }
+    dash_free_index(&index);
+}
+
+static void test_reparse(void)
+{
+    dash_Longopt options[OPTION_COUNT + 1];
+    Values values;
+    char* first[] = {"program", "--verbatim", "text", "-j", "4", NULL};
+    char* second[] = {"program", "--verbatim=text", "-j", "5", "-q", NULL};
+    char* wrong[] = {"program", "--unknown", NULL};
+    int argc = 5;
+    uint64_t changed;
+    char* verbatim;
+    dash_Arena arena = {0};
+    dash_Error error;
+
+    build_table(options, &values);
+    CHECK(dash_arg_parser(&argc, first, options));
+    verbatim = values.verbatim;
+    argc = 5;
+    CHECK(dash_reparse(&argc, second, options, &(dash_Settings) {0}, &changed));
+    CHECK(changed == ((uint64_t) 1 << 5 | (uint64_t) 1 << 11));
+    CHECK(values.verbatim == verbatim && values.jobs == 5 && values.quiet);
+    argc = 2;
+    CHECK(!dash_reparse(&argc, wrong, options, &(dash_Settings) {0}, &changed));
+    CHECK(values.verbatim == verbatim && values.jobs == 5 && values.quiet);
+    argc = 5;
+    CHECK(!dash_reparse(&argc, first, options, &(dash_Settings) {.arena = &arena, .error = &error}, &changed));
+    CHECK(error.code == DASH_ERROR_INVALID_TABLE && values.jobs == 5);
+    dash_free(options);
+}
+
+// Two options writing the same variable, each value must be compared and freed once
+static void test_shared_reparse(void)
+{
+    char* shared = NULL;
+    dash_Longopt options[] = {
+        {.opt_name = 'a', .param_name = "value", .user_pointer = &shared},
+        {.opt_name = 'b', .param_name = "value", .user_pointer = &shared},
+        {0}
+    };
+    char* first[] = {"program", "-a", "x", NULL};
+    char* second[] = {"program", "-b", "y", NULL};
+    char* same[] = {"program", "-a", "y", NULL};
+    char* wrong[] = {"program", "-b", "z", "--unknown", NULL};
+    int argc = 3;
+    uint64_t changed;
+    char* kept;
+
+    CHECK(dash_arg_parser(&argc, first, options));
+    argc = 3;
+    CHECK(dash_reparse(&argc, second, options, &(dash_Settings) {0}, &changed));
+    CHECK(changed == 3 && shared != NULL && !strcmp(shared, "y"));
+    kept = shared;
+    argc = 3;
+    CHECK(dash_reparse(&argc, same, options, &(dash_Settings) {0}, &changed));
+    CHECK(changed == 0 && shared == kept);
+    argc = 4;
+    CHECK(!dash_reparse(&argc, wrong, options, &(dash_Settings) {0}, &changed));
+    CHECK(shared == kept && !strcmp(shared, "y"));
+    dash_free(options);
+    CHECK(shared == NULL);
+}
+
+static void test_snapshot(void)
+{
+    dash_Longopt options[OPTION_COUNT + 1];
+    dash_Longopt restored_options[OPTION_COUNT + 1];
+    Values values;
+    Values restored;
+    char* argv[] = {"program", "-Ia", "-Ib", "--color", "--ratio=0.5", "--timeout=2m", "-cc", "-o", "out", NULL};
+    int argc = 9;
+    char expected[1024];
+    char actual[1024];
+    dash_Error error;
+    size_t size;
+    void* image;
+    bool untouched = true;
+
+    build_table(options, &values);
+    CHECK(dash_arg_parser(&argc, argv, options));
+    size = dash_snapshot(NULL, 0, options);
+    image = malloc(size);
+    memset(image, 0xa5, size);
+    CHECK(dash_snapshot(image, size - 1, options) == size);
+    for (size_t i = 0; i < size; i++)
+    {
+        untouched &= ((unsigned char*) image)[i] == 0xa5;
+    }
+    CHECK(untouched);
+    CHECK(dash_snapshot(image, size, options) == size);
+
+    build_table(restored_options, &restored);
+    CHECK(dash_restore(image, size, restored_options, &(dash_Settings) {.error = &error}));
+    format_values(expected, &values);
+    format_values(actual, &restored);
+    CHECK(!strcmp(expected, actual));
+    dash_free_ex(restored_options, &(dash_Settings) {.flags = DASH_ZERO_COPY});
+
+    // Another table refuses the image
+    restored_options[7].type = DASH_TYPE_INT64;
+    CHECK(!dash_restore(image, size, restored_options, &(dash_Settings) {.error = &error}));
+    CHECK(error.code == DASH_ERROR_SNAPSHOT_MISMATCH);
+    free(image);
+    dash_free(options);
+}
+
+// Global rules only apply to the global options, the command table has other options at the same indexes
+static void test_command_constraints(void)
+{
+    bool verbose = false;
+    bool quiet = false;
+    bool force = false;
+    bool all = false;
+    dash_Longopt global_options[] = {
+        {.opt_name = 'v', .longopt_name = "verbose", .user_pointer = &verbose},
+        {.opt_name = 'q', .longopt_name = "quiet", .user_pointer = &quiet},
+        {0}
+    };
+    dash_Longopt add_options[] = {
+        {.opt_name = 'f', .longopt_name = "force", .user_pointer = &force},
+        {.opt_name = 'A', .longopt_name = "all", .user_pointer = &all},
+        {0}
+    };
+    dash_Command command_table[] = {{"add", "Add files", add_options}, {0}};
+    dash_Constraint rules[] = {{DASH_RULE_REQUIRED, "--verbose"}, {DASH_RULE_EXCLUSIVE, "--verbose --quiet"}, {0}};
+    dash_Constraints constraints;
+    dash_Commands commands;
+    const dash_Command* command;
+    dash_Error error;
+    dash_Settings settings = {.error = &error, .constraints = &constraints};
+    char* given[] = {"program", "-v", "add", "-f", "-A", NULL};
+    char* missing[] = {"program", "add", "-f", NULL};
+    char* both[] = {"program", "-vq", "add", NULL};
+    int argc;
+
+    CHECK(dash_constraints_init(&constraints, global_options, rules, &error));
+    CHECK(dash_commands_init(&commands, global_options, command_table));
+
+    argc = 5;
+    CHECK(dash_parse_command(&commands, &argc, given, &command, &settings));
+    CHECK(command == &command_table[0] && verbose && force && all);
+    dash_free(add_options);
+
+    argc = 3;
+    CHECK(!dash_parse_command(&commands, &argc, missing, &command, &settings));
+    CHECK(error.code == DASH_ERROR_REQUIRED_OPTION && error.constraint == 0 && error.option_index == 0);
+
+    argc = 3;
+    CHECK(!dash_parse_command(&commands, &argc, both, &command, &settings));
+    CHECK(error.code == DASH_ERROR_EXCLUSIVE_OPTIONS && error.constraint == 1 && error.option_index == 1);
+    CHECK(!strcmp(error.argument, "--verbose --quiet"));
+
+    dash_free(global_options);
+    dash_commands_free(&commands);
+    dash_constraints_free(&constraints);
+}
+
+static void format_generated(char* buffer, bool ok, const generated_Arguments* arguments, int argc, char** argv)
+{
+    size_t length = (size_t) sprintf(buffer, "%d i%d s%d a%d f%d h%d p%d q%d c=%s o=%s/%d w=%s/%d |", ok, arguments->interactive,
+        arguments->stdin, arguments->all, arguments->force, arguments->help, arguments->hexp, arguments->hexq,
+        arguments->command ? arguments->command : "-", arguments->option ? arguments->option : "-", arguments->option_unset,
+        arguments->with ? arguments->with : "-", arguments->with_unset);
+
+    for (int i = 0; ok && i < argc; i++)
+    {
+        length += (size_t) sprintf(buffer + length, " %s", argv[i]);
+    }
+}
+
+// The parser dashgen writes for test.dash must behave exactly like dash_arg_parser on the same table
+static void test_generated_parser(void)
+{
+    static const char* const tokens[] = {
+        "-i", "--interactive", "-c", "--command", "--command=x", "-cx", "-s", "--stdin", "-a", "+a", "-f", "+f", "-o", "+o",
+        "-ox", "+ox", "-w", "+w", "-wx", "--with", "--with=x", "--help", "--help=3", "--hex", "--hexp", "--unknown", "--",
+        "-", "x", "-aif", "+af", "-q", "+i"
+    };
+    generated_Arguments generated;
+    generated_Arguments reference;
+    dash_Longopt options[generated_OPTION_COUNT + 1];
+    char* generated_argv[MAX_TOKENS + 1];
+    char* reference_argv[MAX_TOKENS + 1];
+    char generated_text[512];
+    char reference_text[512];
+    int generated_argc;
+    int reference_argc;
+    int argc;
+    int mismatches = 0;
+
+    srand(2);
+    for (int iteration = 0; iteration < ITERATIONS; iteration++)
+    {
+        argc = 1 + rand() % (MAX_TOKENS - 1);
+        generated_argv[0] = reference_argv[0] = "program";
+        for (int i = 1; i < argc; i++)
+        {
+            generated_argv[i] = reference_argv[i] = (char*) tokens[rand() % (sizeof(tokens) / sizeof(tokens[0]))];
+        }
+        generated_argv[argc] = reference_argv[argc] = NULL;
+        generated_argc = reference_argc = argc;
+
+        memset(&generated, 0, sizeof(generated));
+        memset(&reference, 0, sizeof(reference));
+        generated_options(&reference, options);
+        format_generated(generated_text, generated_arg_parser(&generated_argc, generated_argv, &generated), &generated,
+            generated_argc, generated_argv);
+        format_generated(reference_text, dash_arg_parser(&reference_argc, reference_argv, options), &reference, reference_argc,
+            reference_argv);
+        if (strcmp(generated_text, reference_text) && mismatches++ < 5)
+        {
+            fprintf(stderr, "generated parser differs:");
+            for (int i = 1; i < argc; i++)
+            {
+                fprintf(stderr, " '%s'", reference_argv[i]);
+            }
+            fprintf(stderr, "\n  generated %s\n  reference %s\n", generated_text, reference_text);
+        }
+        generated_free(&generated);
+        dash_free(options);
+    }
+    CHECK(mismatches == 0);
+}
+
+// Every buffer size must give a '\0'-terminated prefix of the same text and the full length, like snprintf
+static void test_usage_truncation(void)
+{
+    const char* required_arguments[] = {"file", NULL};
+    dash_Longopt options[OPTION_COUNT + 1];
+    Values values;
+    dash_Usage usage;
+    char full[4096];
+    char buffer[4096];
+    size_t length;
+    size_t written;
+    int failures = 0;
+
+    build_table(options, &values);
+    for (int colors = 0; colors < 2; colors++)
+    {
+        length = dash_format_usage(NULL, 0, "program", "header", "footer", required_arguments, options, colors);
+        CHECK(length > 0 && length < sizeof(full));
+        CHECK(dash_format_usage(full, sizeof(full), "program", "header", "footer", required_arguments, options, colors) == length);
+        CHECK(strlen(full) == length);
+        for (size_t size = 0; size <= length + 1; size++)
+        {
+            memset(buffer, '#', sizeof(buffer));
+            written = dash_format_usage(buffer, size, "program", "header", "footer", required_arguments, options, colors);
+            if (written != length || buffer[size] != '#'
+                || (size > 0 && (buffer[size - 1] != '\0' || memcmp(buffer, full, size - 1))))
+            {
+                failures++;
+            }
+        }
+        CHECK(dash_usage_build(&usage, "program", "header", "footer", required_arguments, options, colors));
+        CHECK(usage.length == length && !memcmp(usage.text, full, length));
+        dash_usage_free(&usage);
+    }
+    CHECK(failures == 0);
+}
+
+static void write_file(const char* path, const char* content, size_t length)
+{
+    FILE* file = fopen(path, "wb");
+
+    CHECK(file != NULL);
+    if (file != NULL)
+    {
+        fwrite(content, 1, length, file);
+        fclose(file);
+    }
+}
+
+static bool expand(const char* const arguments[], int count, const char* const expected[], int expected_count, dash_Error* error)
+{
+    char* original[8];
+    char** argv = original;
+    int argc = count;
+    dash_Responses responses;
+    bool same;
+
+    memcpy(original, arguments, count * sizeof(char*));
+    original[count] = NULL;
+    if (!dash_expand_response_files(&argc, &argv, &responses, error))
+    {
+        return false;
+    }
+    same = argc == expected_count && argv[argc] == NULL;
+    for (int i = 0; same && i < argc; i++)
+    {
+        same = !strcmp(argv[i], expected[i]);
+    }
+    dash_free_responses(&responses);
+    return same;
+}
+
+// Response files are written in build/, where make test runs the test from
+static void test_response_files(void)
+{
+    static const char outer[] = "-i\n@build/test_inner.rsp\n\"two\\tparts\" ignored\n\n--\n@kept\r\n";
+    static const char inner[] = "--command=x\n'single\nquoted'\n@build/test_records.rsp\n";
+    static const char records[] = "first\0with space\0last";
+    const char* const nested[] = {"program", "@build/test_outer.rsp", "after"};
+    const char* const nested_expected[] = {"program", "-i", "--command=x", "single\nquoted", "first", "with space", "last",
+        "two\tparts", "--", "@kept", "after"};
+    const char* const unterminated[] = {"program", "-i", "@build/test_unterminated.rsp"};
+    const char* const looping[] = {"program", "@build/test_loop.rsp"};
+    const char* const missing[] = {"program", "@build/test_missing.rsp"};
+    const char* const untouched[] = {"program", "-i", "--", "@build/test_missing.rsp"};
+    dash_Error error;
+
+    write_file("build/test_outer.rsp", outer, sizeof(outer) - 1);
+    write_file("build/test_inner.rsp", inner, sizeof(inner) - 1);
+    write_file("build/test_records.rsp", records, sizeof(records) - 1);
+    write_file("build/test_unterminated.rsp", "-x\n\"never closed\n", 17);
+    write_file("build/test_loop.rsp", "@build/test_loop.rsp\n", 21);
+    remove("build/test_missing.rsp");
+
+    CHECK(expand(nested, 3, nested_expected, 11, &error));
+    CHECK(expand(untouched, 4, untouched, 4, &error));
+    CHECK(!expand(unterminated, 3, NULL, 0, &error));
+    CHECK(error.code == DASH_ERROR_RESPONSE_SYNTAX && error.argument_index == 2);
+    CHECK(!expand(looping, 2, NULL, 0, &error));
+    CHECK(error.code == DASH_ERROR_RESPONSE_FILE && error.argument_index == 1);
+    CHECK(!expand(missing, 2, NULL, 0, &error));
+    CHECK(error.code == DASH_ERROR_RESPONSE_FILE && !strcmp(error.argument, "@build/test_missing.rsp"));
+}
+
+#define BATCH_COUNT 1000
+
+// Results come back in the order of the command lines whatever thread parsed them, and match a parse on its own
+static void test_batch_order(void)
+{
+    static char texts[BATCH_COUNT][3][32];
+    static char* argvs[BATCH_COUNT][4];
+    static char* const* argv_list[BATCH_COUNT];
+    static int argcs[BATCH_COUNT];
+    static dash_Result results[BATCH_COUNT];
+    dash_Longopt options[OPTION_COUNT + 1];
+    Values values;
+    dash_Parser parser;
+    dash_Result alone;
+    dash_Batch batch;
+    FILE* file;
+    int failures = 0;
+
+    build_table(options, &values);
+    CHECK(dash_parser_init(&parser, options));
+    for (int i = 0; i < BATCH_COUNT; i++)
+    {
+        snprintf(texts[i][0], sizeof(texts[i][0]), "program");
+        snprintf(texts[i][1], sizeof(texts[i][1]), i % 7 == 3 ? "--unknown=%d" : "--jobs=%d", i);
+        snprintf(texts[i][2], sizeof(texts[i][2]), "file%d", i);
+        for (int j = 0; j < 3; j++)
+        {
+            argvs[i][j] = texts[i][j];
+        }
+        argvs[i][3] = NULL;
+        argv_list[i] = argvs[i];
+        argcs[i] = 3;
+    }
+    CHECK(!dash_parse_batch(&parser, BATCH_COUNT, argcs, argv_list, results, 4));
+    for (int i = 0; i < BATCH_COUNT; i++)
+    {
+        CHECK(dash_result_init(&alone, &parser));
+        dash_parse(&parser, argcs[i], argvs[i], &alone);
+        if (results[i].error.code != alone.error.code || results[i].argument_count != alone.argument_count
+            || (i % 7 == 3) != (results[i].error.code == DASH_ERROR_UNKNOWN_OPTION)
+            || (i % 7 != 3 && (results[i].values[5].number.int64 != i || strcmp(results[i].arguments[0], texts[i][2]))))
+        {
+            failures++;
+        }
+        dash_result_free(&alone);
+        dash_result_free(&results[i]);
+    }
+    CHECK(failures == 0);
+
+    file = fopen("build/test_batch.txt", "w");
+    CHECK(file != NULL);
+    if (file != NULL)
+    {
+        fputs("# jobs\nprogram --jobs=1 'a b'\n\nprogram --unknown\nprogram -j 3 c\\ d\n", file);
+        fclose(file);
+    }
+    CHECK(dash_parse_batch_file(&parser, "build/test_batch.txt", &batch, 2));
+    CHECK(batch.count == 3 && batch.failed == 1);
+    CHECK(batch.count == 3 && batch.lines[0] == 2 && batch.lines[1] == 4 && batch.lines[2] == 5);
+    CHECK(batch.count == 3 && !strcmp(batch.results[0].arguments[0], "a b") && batch.results[0].values[5].number.int64 == 1);
+    CHECK(batch.count == 3 && batch.results[1].error.code == DASH_ERROR_UNKNOWN_OPTION);
+    CHECK(batch.count == 3 && !strcmp(batch.results[2].arguments[0], "c d") && batch.results[2].values[5].number.int64 == 3);
+    dash_free_batch(&batch);
+    dash_parser_free(&parser);
+}
+
+static dash_Error_Code convert(dash_Type type, const char* text, dash_Number* number)
+{
+    dash_Longopt options[] = {{.longopt_name = "value", .param_name = "x", .type = type, .user_pointer = number}, {0}};
+    char token[64];
+    char* argv[] = {"program", token, NULL};
+    int argc = 2;
+    dash_Error error;
+
+    snprintf(token, sizeof(token), "--value=%s", text);
+    dash_arg_parser_ex(&argc, argv, options, &(dash_Settings) {.error = &error});
+    return error.code;
+}
+
+static bool converts_to_int64(const char* text, int64_t expected)
+{
+    dash_Number number;
+
+    return convert(DASH_TYPE_INT64, text, &number) == DASH_ERROR_NONE && number.int64 == expected;
+}
+
+static bool converts_to_uint64(dash_Type type, const char* text, uint64_t expected)
+{
+    dash_Number number;
+
+    return convert(type, text, &number) == DASH_ERROR_NONE && number.uint64 == expected;
+}
+
+// Both paths of the double conversion must give the bits strtod gives in the "C" locale the test runs in
+static bool converts_like_strtod(const char* text)
+{
+    dash_Number number;
+    double expected = strtod(text, NULL);
+
+    return convert(DASH_TYPE_DOUBLE, text, &number) == DASH_ERROR_NONE && !memcmp(&number.real, &expected, sizeof(double));
+}
+
+static void test_typed_values(void)
+{
+    static const char* const doubles[] = {
+        "0", "-0", "1", "+1.5", ".5", "5.", "0.1", "2.5e-3", "1e22", "1e-22", "1e23", "9007199254740992", "9007199254740993",
+        "123456789012345678901234567890", "0.000000000000000000000000000001", "1.7976931348623157e308", "4.9e-324", "1e-400"
+    };
+    dash_Number number;
+    char text[64];
+    uint64_t integer;
+    int fraction_digits;
+    int fraction;
+    int exponent;
+    int mismatches = 0;
+
+    CHECK(converts_to_int64("9223372036854775807", INT64_MAX));
+    CHECK(converts_to_int64("-9223372036854775808", INT64_MIN));
+    CHECK(converts_to_int64("+42", 42));
+    CHECK(convert(DASH_TYPE_INT64, "9223372036854775808", &number) == DASH_ERROR_OUT_OF_RANGE);
+    CHECK(convert(DASH_TYPE_INT64, "-9223372036854775809", &number) == DASH_ERROR_OUT_OF_RANGE);
+    CHECK(convert(DASH_TYPE_INT64, "12x", &number) == DASH_ERROR_INVALID_VALUE);
+    CHECK(convert(DASH_TYPE_INT64, "-", &number) == DASH_ERROR_INVALID_VALUE);
+    CHECK(convert(DASH_TYPE_INT64, "", &number) == DASH_ERROR_MISSING_ARGUMENT);
+
+    CHECK(converts_to_uint64(DASH_TYPE_UINT64, "18446744073709551615", UINT64_MAX));
+    CHECK(convert(DASH_TYPE_UINT64, "18446744073709551616", &number) == DASH_ERROR_OUT_OF_RANGE);
+    CHECK(convert(DASH_TYPE_UINT64, "-1", &number) == DASH_ERROR_INVALID_VALUE);
+
+    for (size_t i = 0; i < sizeof(doubles) / sizeof(doubles[0]); i++)
+    {
+        mismatches += !converts_like_strtod(doubles[i]);
+    }
+    // Random digits on both sides of the 2^53 and 10^22 limits of the fast path
+    srand(3);
+    for (int i = 0; i < ITERATIONS; i++)
+    {
+        integer = ((uint64_t) rand() << 31 | (uint64_t) rand()) % ((uint64_t) 1 << (rand() % 60 + 1));
+        fraction_digits = rand() % 8 + 1;
+        fraction = rand() % 1000;
+        exponent = rand() % 80 - 40;
+        snprintf(text, sizeof(text), "%s%" PRIu64 ".%0*de%d", rand() % 2 ? "-" : "", integer, fraction_digits, fraction, exponent);
+        if (!converts_like_strtod(text) && mismatches++ < 5)
+        {
+            fprintf(stderr, "double differs from strtod: %s\n", text);
+        }
+    }
+    CHECK(mismatches == 0);
+    CHECK(convert(DASH_TYPE_DOUBLE, "1e309", &number) == DASH_ERROR_OUT_OF_RANGE);
+    CHECK(convert(DASH_TYPE_DOUBLE, "1e", &number) == DASH_ERROR_INVALID_VALUE);
+    CHECK(convert(DASH_TYPE_DOUBLE, "1,5", &number) == DASH_ERROR_INVALID_VALUE);
+    CHECK(convert(DASH_TYPE_DOUBLE, "nan", &number) == DASH_ERROR_INVALID_VALUE);
+
+    CHECK(converts_to_uint64(DASH_TYPE_SIZE, "512", 512));
+    CHECK(converts_to_uint64(DASH_TYPE_SIZE, "4K", 4096));
+    CHECK(converts_to_uint64(DASH_TYPE_SIZE, "2G", (uint64_t) 2 << 30));
+    CHECK(converts_to_uint64(DASH_TYPE_SIZE, "17179869183G", (((uint64_t) 1 << 34) - 1) << 30));
+    CHECK(convert(DASH_TYPE_SIZE, "17179869184G", &number) == DASH_ERROR_OUT_OF_RANGE);
+    CHECK(convert(DASH_TYPE_SIZE, "18446744073709551616", &number) == DASH_ERROR_OUT_OF_RANGE);
+    CHECK(convert(DASH_TYPE_SIZE, "1T", &number) == DASH_ERROR_INVALID_VALUE);
+
+    CHECK(converts_to_uint64(DASH_TYPE_DURATION, "250ms", 250));
+    CHECK(converts_to_uint64(DASH_TYPE_DURATION, "30s", 30000));
+    CHECK(converts_to_uint64(DASH_TYPE_DURATION, "5m", 300000));
+    CHECK(converts_to_uint64(DASH_TYPE_DURATION, "307445734561825m", UINT64_C(307445734561825) * 60000));
+    CHECK(convert(DASH_TYPE_DURATION, "307445734561826m", &number) == DASH_ERROR_OUT_OF_RANGE);
+    CHECK(convert(DASH_TYPE_DURATION, "30", &number) == DASH_ERROR_INVALID_VALUE);
+}
+
+typedef struct {
+    int64_t jobs;
+    int verbose;
+    bool color;
+    char* name;
+    dash_List tag;
+} Fallbacks;
+
+#define FALLBACK_COUNT 5
+
+static void build_fallbacks(dash_Longopt* options, Fallbacks* values)
+{
+    dash_Longopt table[FALLBACK_COUNT + 1] = {
+        {.opt_name = 'j', .longopt_name = "jobs", .param_name = "n", .type = DASH_TYPE_INT64, .user_pointer = &values->jobs, .env_name = "TEST_JOBS"},
+        {.opt_name = 'v', .longopt_name = "verbose", .type = DASH_TYPE_COUNT, .user_pointer = &values->verbose, .env_name = "TEST_VERBOSE"},
+        {.longopt_name = "color", .user_pointer = &values->color, .env_name = "TEST_COLOR"},
+        {.longopt_name = "name", .param_name = "text", .user_pointer = &values->name, .env_name = "TEST_NAME"},
+        {.longopt_name = "tag", .param_name = "name", .type = DASH_TYPE_LIST, .user_pointer = &values->tag},
+        {0}
+    };
+
+    memset(values, 0, sizeof(*values));
+    memcpy(options, table, sizeof(table));
+}
+
+// The parser compacts argv, so every call works on a copy of the arguments
+static bool parse_fallbacks(const char* const arguments[], dash_Longopt* options, Fallbacks* values, const dash_Settings* settings)
+{
+    char* argv[8];
+    int argc = 0;
+
+    for (; arguments[argc] != NULL; argc++)
+    {
+        argv[argc] = (char*) arguments[argc];
+    }
+    argv[argc] = NULL;
+    build_fallbacks(options, values);
+    return dash_arg_parser_ex(&argc, argv, options, settings);
+}
+
+static void test_environment(void)
+{
+    const char* const empty[] = {"program", NULL};
+    const char* const given[] = {"program", "-j", "4", "--name=x", NULL};
+    dash_Longopt options[FALLBACK_COUNT + 1];
+    Fallbacks values;
+    dash_Error error;
+    dash_Settings settings = {.error = &error};
+
+    setenv("TEST_JOBS", "8", 1);
+    setenv("TEST_VERBOSE", "3", 1);
+    setenv("TEST_COLOR", "Yes", 1);
+    setenv("TEST_NAME", "from environment", 1);
+    CHECK(parse_fallbacks(empty, options, &values, &settings));
+    CHECK(values.jobs == 8 && values.verbose == 3 && values.color && values.name != NULL && !strcmp(values.name, "from environment"));
+    dash_free_ex(options, &settings);
+    CHECK(parse_fallbacks(given, options, &values, &settings));
+    CHECK(values.jobs == 4 && values.verbose == 3 && values.name != NULL && !strcmp(values.name, "x"));
+    dash_free_ex(options, &settings);
+    settings.flags = DASH_ZERO_COPY;
+    CHECK(parse_fallbacks(empty, options, &values, &settings));
+    CHECK(values.name != NULL && !strcmp(values.name, "from environment"));
+    dash_free_ex(options, &settings);
+    settings.flags = 0;
+
+    setenv("TEST_COLOR", "maybe", 1);
+    CHECK(!parse_fallbacks(empty, options, &values, &settings));
+    CHECK(error.code == DASH_ERROR_INVALID_VALUE && error.option_index == 2 && error.argument_index == -1);
+    CHECK(error.argument != NULL && !strcmp(error.argument, "TEST_COLOR=maybe"));
+    dash_free_ex(options, &settings);
+    setenv("TEST_COLOR", "off", 1);
+    setenv("TEST_JOBS", "many", 1);
+    CHECK(!parse_fallbacks(empty, options, &values, &settings));
+    CHECK(error.code == DASH_ERROR_INVALID_VALUE && error.option_index == 0);
+    dash_free_ex(options, &settings);
+    // The command line wins before the variable is ever converted
+    CHECK(parse_fallbacks(given, options, &values, &settings));
+    CHECK(values.jobs == 4 && !values.color);
+    dash_free_ex(options, &settings);
+    unsetenv("TEST_JOBS");
+    unsetenv("TEST_VERBOSE");
+    unsetenv("TEST_COLOR");
+    unsetenv("TEST_NAME");
+}
+
+static bool load_config(dash_Config* config, const char* path, const char* content, dash_Error* error)
+{
+    write_file(path, content, strlen(content));
+    return dash_config_load(config, path, error);
+}
+
+static void test_config_file(void)
+{
+    const char* const empty[] = {"program", NULL};
+    const char* const given[] = {"program", "-j", "4", "--tag=c", NULL};
+    dash_Longopt options[FALLBACK_COUNT + 1];
+    Fallbacks values;
+    dash_Config config;
+    dash_Error error;
+    dash_Settings settings = {.error = &error, .config = &config};
+
+    CHECK(load_config(&config, "build/test.conf", "# Settings\njobs = 16\n; other\n\nname =  from file  \r\ntag = a\ntag=b\ncolor = on\n", &error));
+    CHECK(parse_fallbacks(empty, options, &values, &settings));
+    CHECK(values.jobs == 16 && values.color && values.name != NULL && !strcmp(values.name, "from file"));
+    CHECK(values.tag.count == 2 && !strcmp(values.tag.values[0], "a") && !strcmp(values.tag.values[1], "b"));
+    dash_free_ex(options, &settings);
+    setenv("TEST_JOBS", "8", 1);
+    CHECK(parse_fallbacks(empty, options, &values, &settings));
+    CHECK(values.jobs == 8);
+    dash_free_ex(options, &settings);
+    CHECK(parse_fallbacks(given, options, &values, &settings));
+    CHECK(values.jobs == 4 && values.tag.count == 1 && !strcmp(values.tag.values[0], "c"));
+    dash_free_ex(options, &settings);
+    unsetenv("TEST_JOBS");
+    dash_config_free(&config);
+
+    // Errors point at the key or the value at fault, with a line and a column counted from 1
+    CHECK(load_config(&config, "build/test.conf", "jobs = 16\n\n  unknown = 3\n", &error));
+    CHECK(!parse_fallbacks(empty, options, &values, &settings));
+    CHECK(error.code == DASH_ERROR_UNKNOWN_OPTION && error.line == 3 && error.column == 3 && !strcmp(error.argument, "unknown"));
+    dash_free_ex(options, &settings);
+    dash_config_free(&config);
+    CHECK(load_config(&config, "build/test.conf", "jobs =   x1\n", &error));
+    CHECK(!parse_fallbacks(empty, options, &values, &settings));
+    CHECK(error.code == DASH_ERROR_INVALID_VALUE && error.line == 1 && error.column == 10 && !strcmp(error.argument, "x1"));
+    dash_free_ex(options, &settings);
+    dash_config_free(&config);
+    CHECK(load_config(&config, "build/test.conf", "name = a\nname = b\n", &error));
+    CHECK(!parse_fallbacks(empty, options, &values, &settings));
+    CHECK(error.code == DASH_ERROR_ALREADY_SET && error.line == 2);
+    dash_free_ex(options, &settings);
+    dash_config_free(&config);
+
+    CHECK(!load_config(&config, "build/test.conf", "jobs = 1\njobs 16\n", &error));
+    CHECK(error.code == DASH_ERROR_CONFIG_SYNTAX && error.line == 2 && !strcmp(error.argument, "build/test.conf"));
+    remove("build/test_missing.conf");
+    CHECK(!dash_config_load(&config, "build/test_missing.conf", &error));
+    CHECK(error.code == DASH_ERROR_CONFIG_FILE && !strcmp(error.argument, "build/test_missing.conf"));
+}
+
+static void test_iterator(void)
+{
+    char* argv[] = {"program", "-vq", "file1", "-j5", "+v", "--tag", "x", "-o", "out", "--color=auto", "--", "-i", NULL};
+    char* optional[] = {"program", "--color", NULL};
+    char* failing[] = {"program", "-v", "file1", "--unknown", "-q", NULL};
+    const dash_Item expected[] = {
+        {0, 1, NULL, false}, {11, 1, NULL, false}, {-1, 2, "file1", false}, {5, 3, "5", false}, {0, 4, NULL, true},
+        {13, 6, "x", false}, {15, 8, "out", false}, {4, 9, "auto", false}, {-1, 11, "-i", false}
+    };
+    dash_Longopt options[OPTION_COUNT + 1];
+    Values values;
+    dash_Iterator iterator;
+    dash_Item item;
+    int count = 0;
+    int failures = 0;
+
+    build_table(options, &values);
+    dash_begin(&iterator, 12, argv, options, NULL);
+    while (dash_next(&iterator, &item))
+    {
+        if (count >= (int) (sizeof(expected) / sizeof(expected[0])) || item.option_index != expected[count].option_index
+            || item.argument_index != expected[count].argument_index || item.unset != expected[count].unset
+            || (item.value == NULL) != (expected[count].value == NULL) || (item.value != NULL && strcmp(item.value, expected[count].value)))
+        {
+            failures++;
+        }
+        count++;
+    }
+    CHECK(failures == 0 && count == (int) (sizeof(expected) / sizeof(expected[0])));
+    CHECK(iterator.error.code == DASH_ERROR_NONE);
+    // Nothing was stored and argv wasn't reordered
+    CHECK(!values.verbose && values.jobs == 0 && !strcmp(argv[2], "file1") && !strcmp(argv[11], "-i"));
+
+    dash_begin(&iterator, 2, optional, options, NULL);
+    CHECK(dash_next(&iterator, &item) && item.option_index == 4 && item.value != NULL && item.value[0] == '\0');
+    CHECK(!dash_next(&iterator, &item) && iterator.error.code == DASH_ERROR_NONE);
+
+    // An error is only found when it is reached, so the caller can stop before it
+    dash_begin(&iterator, 5, failing, options, NULL);
+    CHECK(dash_next(&iterator, &item) && item.option_index == 0);
+    CHECK(dash_next(&iterator, &item) && item.option_index == -1 && item.argument_index == 2);
+    CHECK(!dash_next(&iterator, &item) && iterator.error.code == DASH_ERROR_UNKNOWN_OPTION && iterator.error.argument_index == 3);
+    CHECK(!dash_next(&iterator, &item));
+}
+
+static int compare_lines(const void* first, const void* second)
+{
+    return strcmp(*(char* const*) first, *(char* const*) second);
+}
+
+// Candidates come in the order of the table without an index and sorted with one, the shell sorts them anyway
+static void sort_lines(char* text)
+{
+    char copy[1024];
+    char* lines[64];
+    int count = 0;
+    size_t length = 0;
+
+    snprintf(copy, sizeof(copy), "%s", text);
+    for (char* line = strtok(copy, "\n"); line != NULL && count < 64; line = strtok(NULL, "\n"))
+    {
+        lines[count++] = line;
+    }
+    qsort(lines, count, sizeof(char*), compare_lines);
+    for (int i = 0; i < count; i++)
+    {
+        length += (size_t) sprintf(text + length, "%s\n", lines[i]);
+    }
+}
+
+static bool completes_to(const char* line, size_t position, const dash_Longopt* options, const dash_Settings* settings, const char* expected)
+{
+    char buffer[512];
+    size_t length = dash_format_completions(buffer, sizeof(buffer), line, position, options, settings);
+
+    sort_lines(buffer);
+    return length == strlen(expected) && !strcmp(buffer, expected);
+}
+
+static void test_completions(void)
+{
+    bool verbose;
+    char* output;
+    bool over;
+    dash_Longopt options[] = {
+        {.opt_name = 'v', .longopt_name = "verbose", .allow_flag_unset = true, .user_pointer = &verbose, .description = "Talk more"},
+        {.opt_name = 'o', .longopt_name = "output", .param_name = "file", .user_pointer = &output},
+        {.longopt_name = "over", .user_pointer = &over},
+        {0}
+    };
+    dash_Longopt table[OPTION_COUNT + 1];
+    Values values;
+    dash_Index index;
+    dash_Settings indexed = {.index = &index};
+    char line[64];
+    char linear_text[1024];
+    char indexed_text[1024];
+    char small[8];
+    char script[4096];
+    int mismatches = 0;
+
+    CHECK(dash_compile_options(&index, options));
+    for (int i = 0; i < 2; i++)
+    {
+        const dash_Settings* settings = i == 0 ? NULL : &indexed;
+
+        CHECK(completes_to("prog --ov", 9, options, settings, "--over\n"));
+        CHECK(completes_to("prog --o", 8, options, settings, "--output\tfile\n--over\n"));
+        CHECK(completes_to("prog -", 6, options, settings, "--output\tfile\n--over\n--verbose\tTalk more\n-o\tfile\n-v\tTalk more\n"));
+        CHECK(completes_to("prog +", 6, options, settings, "+v\tTalk more\n"));
+        CHECK(completes_to("prog --o --ver", 14, options, settings, "--verbose\tTalk more\n"));
+        // Only the line up to the cursor counts
+        CHECK(completes_to("prog --ov --x", 9, options, settings, "--over\n"));
+        // Positional arguments, parameters and anything after -- are left to the shell
+        CHECK(completes_to("prog x", 6, options, settings, ""));
+        CHECK(completes_to("prog --output ", 14, options, settings, ""));
+        CHECK(completes_to("prog -- --o", 11, options, settings, ""));
+    }
+    CHECK(dash_format_completions(small, sizeof(small), "prog --o", 8, options, NULL) == 21);
+    CHECK(!strcmp(small, "--outpu"));
+    dash_free_index(&index);
+
+    // The sorted names of an index must give what the linear scan of the table gives, for every prefix
+    build_table(table, &values);
+    CHECK(dash_compile_options(&index, table));
+    for (int i = 0; i < OPTION_COUNT; i++)
+    {
+        for (size_t length = 0; table[i].longopt_name != NULL && length <= strlen(table[i].longopt_name); length++)
+        {
+            snprintf(line, sizeof(line), "program -v --%.*s", (int) length, table[i].longopt_name);
+            dash_format_completions(linear_text, sizeof(linear_text), line, strlen(line), table, NULL);
+            dash_format_completions(indexed_text, sizeof(indexed_text), line, strlen(line), table, &indexed);
+            sort_lines(linear_text);
+            sort_lines(indexed_text);
+            mismatches += strcmp(linear_text, indexed_text) != 0;
+        }
+    }
+    CHECK(mismatches == 0);
+    dash_free_index(&index);
+
+    CHECK(dash_format_completion_script(script, sizeof(script), "prog", DASH_SHELL_BASH, options) < sizeof(script));
+    CHECK(strstr(script, "compgen -W '-v --verbose -o --output --over'") != NULL && strstr(script, "complete -o default -F _prog prog") != NULL);
+    CHECK(dash_format_completion_script(script, sizeof(script), "prog", DASH_SHELL_ZSH, options) < sizeof(script));
+    CHECK(strstr(script, "#compdef prog") != NULL && strstr(script, "{'-v','--verbose'}'[Talk more]'") != NULL);
+}
+
+int main(void)
+{
+    test_index_is_neutral();
+    test_abbreviations();
+    test_reparse();
+    test_shared_reparse();
+    test_snapshot();
+    test_command_constraints();
+    test_generated_parser();
+    test_usage_truncation();
+    test_response_files();
+    test_batch_order();
+    test_typed_values();
+    test_environment();
+    test_config_file();
+    test_iterator();
+    test_completions();
+    if (failure_count > 0)
+    {
+        fprintf(stderr, "%d failed checks\n", failure_count);
+        return 1;
+    }
+    puts("All tests passed");
+    return 0;
+}
@@ -0,0 +1,201 @@
+// Tests of dash.hpp, built and run by `make test`.
+//
+// A table declared in C++ must parse random command lines exactly like dash_arg_parser_ex on the C table it gives for
+// the same structure, with and without a run-time index, abbreviations and zero-copy.
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "dash.hpp"
+
+#define ITERATIONS 20000
+#define MAX_TOKENS 12
+
+static int failure_count = 0;
+
+#define CHECK(condition) check(condition, #condition, __LINE__)
+
+static void check(bool ok, const char* text, int line)
+{
+    if (!ok)
+    {
+        fprintf(stderr, "test.cpp:%d: %s\n", line, text);
+        failure_count++;
+    }
+}
+
+struct Arguments
+{
+    bool interactive;
+    char* command;
+    bool stdin_flag;
+    bool all;
+    char* option;
+    bool option_unset;
+    char* with;
+    bool with_unset;
+    bool help;
+    int verbose;
+    int64_t jobs;
+    uint64_t limit;
+    uint64_t timeout;
+    double ratio;
+    dash_List include;
+};
+
+static constexpr auto table = dash::make_table(
+    dash::flag<&Arguments::interactive>('i', "interactive").describe("Start an interactive shell"),
+    dash::param<&Arguments::command>('c', "command", "line").describe("Execute $ as a command"),
+    dash::flag<&Arguments::stdin_flag>('s'),
+    dash::flag<&Arguments::all>('a').unsettable(),
+    dash::param<&Arguments::option>('o', nullptr, "option").optional().unsettable().unset_into<&Arguments::option_unset>(),
+    dash::param<&Arguments::with>('w', "with", "name").unsettable().unset_into<&Arguments::with_unset>(),
+    dash::flag<&Arguments::help>('\0', "help"),
+    dash::count<&Arguments::verbose>('v', "verbose").unsettable(),
+    dash::param<&Arguments::jobs>('j', "jobs", "n"),
+    dash::param<&Arguments::limit>('l', "limit", "bytes", DASH_TYPE_SIZE),
+    dash::param<&Arguments::timeout>('\0', "timeout", "duration", DASH_TYPE_DURATION),
+    dash::param<&Arguments::ratio>('\0', "ratio", "r"),
+    dash::param<&Arguments::include>('I', "include", "dir")
+);
+
+// Everything the table knows is there at compile time
+static_assert(table.size() == 13);
+static_assert(table[1].longopt.opt_name == 'c' && table[1].longopt.param_name != nullptr);
+static_assert(table[4].longopt.param_optional && table[4].longopt.allow_flag_unset && table[4].longopt.longopt_name == nullptr);
+static_assert(table[7].longopt.type == DASH_TYPE_COUNT && table[9].longopt.type == DASH_TYPE_SIZE);
+static_assert(table[11].longopt.type == DASH_TYPE_DOUBLE && table[12].longopt.type == DASH_TYPE_LIST);
+
+static const char* const tokens[] = {
+    "-i", "-c", "x", "-cecho", "--command=v", "--command", "+o", "-o", "+oval", "-", "--", "v1", "-aif", "+a", "-w",
+    "--with=q", "--with", "--help", "--help=1", "-s", "-x", "--he", "--wi=3", "--inter", "--command=", "-vv", "+v",
+    "--verbose", "-j", "12", "--jobs=3x", "--jobs=-4", "-l4k", "--limit=2G", "--timeout=5s", "--timeout=5", "--ratio=0.1",
+    "-Ia", "--include=b", "--j"
+};
+
+static bool same_string(const char* first, const char* second)
+{
+    return first == second || (first != nullptr && second != nullptr && !strcmp(first, second));
+}
+
+static bool same_arguments(const Arguments& first, const Arguments& second)
+{
+    if (first.interactive != second.interactive || first.stdin_flag != second.stdin_flag || first.all != second.all
+        || first.option_unset != second.option_unset || first.with_unset != second.with_unset || first.help != second.help
+        || first.verbose != second.verbose || first.jobs != second.jobs || first.limit != second.limit
+        || first.timeout != second.timeout || memcmp(&first.ratio, &second.ratio, sizeof(double))
+        || first.include.count != second.include.count)
+    {
+        return false;
+    }
+    for (int i = 0; i < first.include.count; i++)
+    {
+        if (!same_string(first.include.values[i], second.include.values[i]))
+        {
+            return false;
+        }
+    }
+    return same_string(first.command, second.command) && same_string(first.option, second.option)
+        && same_string(first.with, second.with);
+}
+
+static void test_same_as_c(void)
+{
+    static const unsigned flag_sets[] = {0, DASH_ABBREVIATIONS, DASH_ZERO_COPY, DASH_ABBREVIATIONS | DASH_ZERO_COPY};
+    const char* chosen[MAX_TOKENS];
+    char* cpp_argv[MAX_TOKENS + 1];
+    char* c_argv[MAX_TOKENS + 1];
+    int mismatches = 0;
+
+    srand(4);
+    for (int iteration = 0; iteration < ITERATIONS; iteration++)
+    {
+        int argc = 1 + rand() % (MAX_TOKENS - 1);
+
+        chosen[0] = "program";
+        for (int i = 1; i < argc; i++)
+        {
+            chosen[i] = tokens[rand() % (sizeof(tokens) / sizeof(tokens[0]))];
+        }
+
+        for (unsigned flags : flag_sets)
+        {
+            // Without DASH_ABBREVIATIONS the C side is linear, the C++ side always has its compile-time index
+            Arguments cpp_values{};
+            Arguments c_values{};
+            auto c_table = table.longopts(c_values);
+            dash_Error cpp_error;
+            dash_Error c_error;
+            dash_Settings cpp_settings{};
+            dash_Settings c_settings{};
+            int cpp_argc = argc;
+            int c_argc = argc;
+            bool cpp_ok;
+            bool c_ok;
+            bool same;
+
+            // Both parsers compact their vector
+            for (int i = 0; i < argc; i++)
+            {
+                cpp_argv[i] = c_argv[i] = const_cast<char*>(chosen[i]);
+            }
+            cpp_argv[argc] = c_argv[argc] = nullptr;
+            cpp_settings.flags = c_settings.flags = flags;
+            cpp_settings.error = &cpp_error;
+            c_settings.error = &c_error;
+            cpp_ok = table.parse(&cpp_argc, cpp_argv, cpp_values, cpp_settings);
+            c_ok = dash_arg_parser_ex(&c_argc, c_argv, c_table.data(), &c_settings);
+
+            same = cpp_ok == c_ok && cpp_error.code == c_error.code && cpp_error.option_index == c_error.option_index
+                && cpp_error.argument_index == c_error.argument_index;
+            if (same && cpp_ok)
+            {
+                same = cpp_argc == c_argc && same_arguments(cpp_values, c_values);
+                for (int i = 0; same && i < cpp_argc; i++)
+                {
+                    same = cpp_argv[i] == c_argv[i];
+                }
+            }
+            if (!same && mismatches++ < 5)
+            {
+                fprintf(stderr, "C++ and C tables differ, flags %u, %s and %s:", flags, dash_error_message(&cpp_error),
+                    dash_error_message(&c_error));
+                for (int i = 1; i < argc; i++)
+                {
+                    fprintf(stderr, " '%s'", chosen[i]);
+                }
+                fprintf(stderr, "\n");
+            }
+            table.free(cpp_values, cpp_settings);
+            dash_free_ex(c_table.data(), &c_settings);
+        }
+    }
+    CHECK(mismatches == 0);
+}
+
+static void test_longopts(void)
+{
+    Arguments values{};
+    auto c_table = table.longopts(values);
+    char usage[4096];
+
+    CHECK(c_table[table.size()].opt_name == '\0' && c_table[table.size()].longopt_name == nullptr);
+    CHECK(c_table[1].user_pointer == &values.command && c_table[4].unset_pointer == &values.option_unset);
+    CHECK(c_table[0].unset_pointer == nullptr && !strcmp(c_table[0].description, "Start an interactive shell"));
+    CHECK(dash_format_usage(usage, sizeof(usage), "program", "header", "footer", nullptr, c_table.data(), false) < sizeof(usage));
+    CHECK(strstr(usage, "--interactive") != nullptr && strstr(usage, "--command") != nullptr);
+}
+
+int main(void)
+{
+    test_same_as_c();
+    test_longopts();
+    if (failure_count > 0)
+    {
+        fprintf(stderr, "%d failed checks\n", failure_count);
+        return 1;
+    }
+    puts("All C++ tests passed");
+    return 0;
+}